@@ -0,0 +1,100 @@
+#ifndef scheduling_advection_scheduler_hxx
+#define scheduling_advection_scheduler_hxx
+
+#include <vector>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Timer.h>
+
+#include "ParticleOrder.hxx"
+
+namespace scheduling
+{
+
+struct ChunkReport
+{
+  // First step of the chunk.
+  vtkm::Id FirstStep;
+  // Particles advected during the chunk.
+  vtkm::Id NumberOfActive;
+  vtkm::Float64 Time;
+};
+
+/*
+ * Advects the particles of a history::ChunkedStateRecordingParticles
+ * ChunkSteps steps at a time instead of all steps in one launch.  Between
+ * chunks the particles that stopped are moved behind the others, so every
+ * chunk only launches the particles still moving, packed at the front of
+ * the arrays.  Particles are also sorted along a Morton curve before the
+ * first chunk, and again every ReorderInterval steps, when asked to.  The
+ * input order is restored at the end.
+ *
+ * With ChunkSteps = 0 the chunks are ReorderInterval steps long, or the
+ * particles are advected in a single launch when that is not positive.
+ */
+class ChunkedAdvection
+{
+public:
+  VTKM_CONT
+  ChunkedAdvection(const vtkm::Bounds& bounds, vtkm::Id chunkSteps, vtkm::Id reorderInterval = -1)
+  : Order(bounds)
+  , ChunkSteps(chunkSteps)
+  , ReorderInterval(reorderInterval)
+  {}
+
+  template <typename HistoryType, typename StepperType>
+  VTKM_CONT
+  void Advect(HistoryType& history, const StepperType& stepper)
+  {
+    this->Reports.clear();
+    if(this->ReorderInterval >= 0)
+      this->Order.Sort(history);
+    vtkm::Id chunkSteps = this->ChunkSteps > 0 ? this->ChunkSteps : this->ReorderInterval;
+    if(chunkSteps <= 0)
+    {
+      history.Advect(stepper);
+      this->Order.Restore(history);
+      return;
+    }
+
+    vtkm::Id sorted = 0;
+    for(vtkm::Id taken = 0; taken < history.GetMaxSteps(); taken += chunkSteps)
+    {
+      if(taken > 0)
+      {
+        if(this->ReorderInterval > 0 && taken - sorted >= this->ReorderInterval)
+        {
+          this->Order.Sort(history);
+          sorted = taken;
+        }
+        else
+          this->Order.Compact(history);
+      }
+      vtkm::cont::Timer timer;
+      timer.Start();
+      vtkm::Id numActive = history.AdvectSteps(stepper, chunkSteps);
+      timer.Stop();
+      if(numActive == 0)
+        break;
+      this->Reports.push_back({ taken, numActive, timer.GetElapsedTime() });
+    }
+    this->Order.Restore(history);
+  }
+
+  VTKM_CONT
+  const std::vector<ChunkReport>& GetReports() const { return this->Reports; }
+
+  VTKM_CONT
+  const locality::ParticleOrder& GetOrder() const { return this->Order; }
+
+private:
+  locality::ParticleOrder Order;
+  vtkm::Id ChunkSteps;
+  vtkm::Id ReorderInterval;
+  std::vector<ChunkReport> Reports;
+};
+
+} // namespace scheduling
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef integration_boris_stepper_hxx
+#define integration_boris_stepper_hxx
+
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/VecVariable.h>
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/AtomicArray.h>
+#include <vtkm/cont/ExecutionObjectBase.h>
+
+#include <vtkm/filter/flow/worklet/GridEvaluatorStatus.h>
+#include <vtkm/filter/flow/worklet/IntegratorStatus.h>
+
+namespace integration
+{
+
+namespace detail
+{
+
+constexpr static vtkm::FloatDefault SPEED_OF_LIGHT_SQ =
+  static_cast<vtkm::FloatDefault>(2.99792458e8 * 2.99792458e8);
+
+} // namespace detail
+
+/*
+ * Execution side of BorisStepper.  One Step advances a particle by DeltaT
+ * with relativistic Boris pushes, split into substeps so that no substep
+ * turns the momentum by more than CflFactor radians of gyration or moves
+ * the particle by more than CflFactor grid cells.  The fields are sampled
+ * again at the start of every substep, so particles in weak fields take a
+ * single push per step and only those in strong fields pay for more.
+ */
+template <typename ExecEvaluatorType>
+class BorisStepperImpl
+{
+public:
+  using StatusType = vtkm::worklet::flow::IntegratorStatus;
+  using CounterType = vtkm::exec::AtomicArrayExecutionObject<vtkm::Id>;
+
+  VTKM_EXEC_CONT
+  BorisStepperImpl(const ExecEvaluatorType& evaluator,
+                   vtkm::FloatDefault deltaT,
+                   vtkm::FloatDefault cflFactor,
+                   vtkm::FloatDefault spacing,
+                   const CounterType& substeps,
+                   vtkm::Id numSlots)
+  : Evaluator(evaluator)
+  , DeltaT(deltaT)
+  , CflFactor(cflFactor)
+  , Spacing(spacing)
+  , Substeps(substeps)
+  , NumSlots(numSlots)
+  {}
+
+  template <typename Particle>
+  VTKM_EXEC StatusType Step(Particle& particle, vtkm::FloatDefault& time, vtkm::Vec3f& outpos) const
+  {
+    const vtkm::FloatDefault qom = particle.Charge / particle.Mass;
+    vtkm::Vec3f pos = particle.Pos;
+    // Momentum per unit mass, u = gamma * v.
+    vtkm::Vec3f u = particle.Momentum / particle.Mass;
+    // Substeps still to take in this step.  The count is planned from the
+    // fields at the start of the step and only raised where the fields get
+    // stronger, every substep covers an equal share of what is left and
+    // the last one exactly the remainder, so the step ends on DeltaT
+    // without comparing accumulated times.
+    vtkm::FloatDefault remaining = this->DeltaT;
+    vtkm::Id planned = 0;
+    vtkm::Id substeps = 0;
+    vtkm::worklet::flow::GridEvaluatorStatus status;
+    do
+    {
+      vtkm::VecVariable<vtkm::Vec3f, 2> fields;
+      status = this->Evaluator.Evaluate(pos, time + (this->DeltaT - remaining), fields);
+      if(status.CheckFail())
+        break;
+      const vtkm::Vec3f eField = fields[0];
+      const vtkm::Vec3f bField = fields[1];
+
+      vtkm::FloatDefault gamma = vtkm::Sqrt(1 + vtkm::MagnitudeSquared(u) / detail::SPEED_OF_LIGHT_SQ);
+      vtkm::FloatDefault limit = remaining;
+      vtkm::FloatDefault omega = vtkm::Abs(qom) * vtkm::Magnitude(bField) / gamma;
+      if(omega > 0)
+        limit = vtkm::Min(limit, this->CflFactor / omega);
+      vtkm::FloatDefault speed = vtkm::Magnitude(u) / gamma;
+      if(speed > 0)
+        limit = vtkm::Min(limit, this->CflFactor * this->Spacing / speed);
+      planned = vtkm::Max(planned, static_cast<vtkm::Id>(vtkm::Ceil(remaining / limit)));
+      vtkm::FloatDefault dt = planned > 1 ? remaining / static_cast<vtkm::FloatDefault>(planned) : remaining;
+
+      const vtkm::Vec3f halfKick = (0.5f * qom * dt) * eField;
+      const vtkm::Vec3f uMinus = u + halfKick;
+      const vtkm::FloatDefault gammaMinus =
+        vtkm::Sqrt(1 + vtkm::MagnitudeSquared(uMinus) / detail::SPEED_OF_LIGHT_SQ);
+      const vtkm::Vec3f t = (0.5f * qom * dt / gammaMinus) * bField;
+      const vtkm::Vec3f s = (2 / (1 + vtkm::MagnitudeSquared(t))) * t;
+      const vtkm::Vec3f uPrime = uMinus + vtkm::Cross(uMinus, t);
+      u = uMinus + vtkm::Cross(uPrime, s) + halfKick;
+      gamma = vtkm::Sqrt(1 + vtkm::MagnitudeSquared(u) / detail::SPEED_OF_LIGHT_SQ);
+      pos = pos + (dt / gamma) * u;
+
+      remaining = planned > 1 ? remaining - dt : 0;
+      planned--;
+      substeps++;
+    } while(planned > 0);
+
+    if(substeps == 0)
+    {
+      outpos = particle.Pos;
+      return StatusType(status, false);
+    }
+    vtkm::Id slot = particle.ID % this->NumSlots;
+    this->Substeps.Add(slot < 0 ? slot + this->NumSlots : slot, substeps);
+    particle.Momentum = particle.Mass * u;
+    outpos = pos;
+    time += this->DeltaT - remaining;
+    // A substep that left the domain ends the step there, which is what
+    // SmallStep does for the fixed-step integrators.
+    return StatusType(true,
+                      status.CheckSpatialBounds(),
+                      status.CheckTemporalBounds(),
+                      status.CheckInGhostCell(),
+                      false);
+  }
+
+  // Step already stops at the first substep leaving the domain, so the
+  // particle is outside whenever this is called.
+  template <typename Particle>
+  VTKM_EXEC StatusType SmallStep(Particle& particle, vtkm::FloatDefault& time, vtkm::Vec3f& outpos) const
+  {
+    vtkm::VecVariable<vtkm::Vec3f, 2> fields;
+    auto status = this->Evaluator.Evaluate(particle.Pos, time, fields);
+    outpos = particle.Pos;
+    return StatusType(status, false);
+  }
+
+private:
+  ExecEvaluatorType Evaluator;
+  vtkm::FloatDefault DeltaT;
+  vtkm::FloatDefault CflFactor;
+  vtkm::FloatDefault Spacing;
+  CounterType Substeps;
+  vtkm::Id NumSlots;
+};
+
+/*
+ * Relativistic Boris pusher with field-aware substepping, usable wherever
+ * vtkm::worklet::flow::Stepper is, with any grid evaluator returning the
+ * E and B fields.  `spacing` is the smallest grid spacing.  The substeps
+ * are counted per particle, in one of `numParticles` slots picked by
+ * particle ID, so the count is not a single contended atomic; the slots
+ * are summed when the count is asked for.
+ */
+template <typename EvaluatorType>
+class BorisStepper : public vtkm::cont::ExecutionObjectBase
+{
+public:
+  VTKM_CONT
+  BorisStepper(const EvaluatorType& evaluator,
+               vtkm::FloatDefault deltaT,
+               vtkm::FloatDefault cflFactor,
+               vtkm::FloatDefault spacing,
+               vtkm::Id numParticles)
+  : Evaluator(evaluator)
+  , DeltaT(deltaT)
+  , CflFactor(cflFactor)
+  , Spacing(spacing)
+  {
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant(vtkm::Id(0), vtkm::Max(numParticles, vtkm::Id(1))),
+                          this->Substeps);
+  }
+
+  VTKM_CONT
+  auto PrepareForExecution(vtkm::cont::DeviceAdapterId device, vtkm::cont::Token& token) const
+  {
+    auto evaluator = this->Evaluator.PrepareForExecution(device, token);
+    using ExecEvaluatorType = decltype(evaluator);
+    return BorisStepperImpl<ExecEvaluatorType>(
+      evaluator, this->DeltaT, this->CflFactor, this->Spacing,
+      vtkm::cont::AtomicArray<vtkm::Id>(this->Substeps).PrepareForExecution(device, token),
+      this->Substeps.GetNumberOfValues());
+  }
+
+  // Boris pushes taken so far by all particles.
+  VTKM_CONT
+  vtkm::Id GetNumberOfSubsteps() const
+  {
+    return vtkm::cont::Algorithm::Reduce(this->Substeps, static_cast<vtkm::Id>(0));
+  }
+
+private:
+  EvaluatorType Evaluator;
+  vtkm::FloatDefault DeltaT;
+  vtkm::FloatDefault CflFactor;
+  vtkm::FloatDefault Spacing;
+  vtkm::cont::ArrayHandle<vtkm::Id> Substeps;
+};
+
+} // namespace integration
+
+#endif
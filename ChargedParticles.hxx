@@ -0,0 +1,222 @@
+#ifndef seeding_charged_particles_hxx
+#define seeding_charged_particles_hxx
+
+#include <vtkm/BinaryOperators.h>
+#include <vtkm/Particle.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandleMultiplexer.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/ArrayHandleSOA.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+namespace seeding
+{
+
+namespace detail
+{
+
+constexpr static vtkm::FloatDefault SPEED_OF_LIGHT =
+  static_cast<vtkm::FloatDefault>(2.99792458e8);
+
+class MakeChargedParticle : public vtkm::worklet::WorkletMapField
+{
+public:
+  MakeChargedParticle() {}
+
+  using ControlSignature = void(FieldIn id,
+                                FieldIn pos,
+                                FieldIn mom,
+                                FieldIn mass,
+                                FieldIn charge,
+                                FieldIn weighting,
+                                FieldOut electron);
+
+  using ExecutionSignature = void(_1, _2, _3, _4, _5, _6, _7);
+
+  VTKM_EXEC
+  void operator()(const vtkm::Id id,
+                  const vtkm::Vec3f& pos,
+                  const vtkm::Vec3f& mom,
+                  const vtkm::FloatDefault& mass,
+                  const vtkm::FloatDefault& charge,
+                  const vtkm::FloatDefault& w,
+                  vtkm::ChargedParticle& electron) const
+  {
+    // Change momentum to SI units
+    auto momentum = mom * mass * SPEED_OF_LIGHT;
+    electron = vtkm::ChargedParticle(pos, id, mass, charge, w, momentum);
+  }
+};
+
+class MomentumToSI : public vtkm::worklet::WorkletMapField
+{
+public:
+  MomentumToSI() {}
+
+  using ControlSignature = void(FieldIn mom, FieldIn mass, FieldOut momentum);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  VTKM_EXEC
+  void operator()(const vtkm::Vec3f& mom,
+                  const vtkm::FloatDefault& mass,
+                  vtkm::Vec3f& momentum) const
+  {
+    momentum = mom * mass * SPEED_OF_LIGHT;
+  }
+};
+
+} // namespace detail
+
+/*
+ * Structure-of-arrays view of a particle species.  Positions and momenta
+ * are kept as the separate x/y/z and ux/uy/uz component arrays of the
+ * species file, momenta in the normalized units of the file.  Mass and
+ * charge are stored as constant arrays when they are the same for every
+ * particle, which is the usual case for a WarpX species.
+ * vtkm::ChargedParticle is only built, via MakeChargedParticles, for the
+ * particles that are actually advected.
+ */
+class ChargedParticles
+{
+public:
+  using IdArrayType =
+    vtkm::cont::ArrayHandleMultiplexer<vtkm::cont::ArrayHandleIndex, vtkm::cont::ArrayHandle<vtkm::Id>>;
+  using VectorArrayType = vtkm::cont::ArrayHandleSOA<vtkm::Vec3f>;
+  using ScalarArrayType = vtkm::cont::ArrayHandle<vtkm::FloatDefault>;
+  using SpeciesArrayType =
+    vtkm::cont::ArrayHandleMultiplexer<vtkm::cont::ArrayHandleConstant<vtkm::FloatDefault>, ScalarArrayType>;
+
+  ChargedParticles()
+  : ConstantMass(false)
+  , ConstantCharge(false)
+  {}
+
+  // Wraps the x, y, z, ux, uy, uz, mass, charge and w fields of a species
+  // dataset without copying them.
+  static ChargedParticles FromDataSet(const vtkm::cont::DataSet& dataset)
+  {
+    auto getField = [&](const std::string& name) {
+      ScalarArrayType values;
+      dataset.GetField(name).GetData().AsArrayHandle(values);
+      return values;
+    };
+    ChargedParticles particles;
+    particles.Positions.SetArray(0, getField("x"));
+    particles.Positions.SetArray(1, getField("y"));
+    particles.Positions.SetArray(2, getField("z"));
+    particles.Momenta.SetArray(0, getField("ux"));
+    particles.Momenta.SetArray(1, getField("uy"));
+    particles.Momenta.SetArray(2, getField("uz"));
+    particles.Weighting = getField("w");
+    particles.Ids = IdArrayType(vtkm::cont::ArrayHandleIndex(particles.Weighting.GetNumberOfValues()));
+    particles.ConstantMass = ChargedParticles::Compress(getField("mass"), particles.Mass);
+    particles.ConstantCharge = ChargedParticles::Compress(getField("charge"), particles.Charge);
+    return particles;
+  }
+
+  vtkm::Id GetNumberOfValues() const { return this->Weighting.GetNumberOfValues(); }
+
+  // Index of every particle in the species it was read from.
+  const IdArrayType& GetIds() const { return this->Ids; }
+  const VectorArrayType& GetPositions() const { return this->Positions; }
+  const VectorArrayType& GetMomenta() const { return this->Momenta; }
+  const SpeciesArrayType& GetMass() const { return this->Mass; }
+  const SpeciesArrayType& GetCharge() const { return this->Charge; }
+  const ScalarArrayType& GetWeighting() const { return this->Weighting; }
+
+  // Gathers the particles at `indices` into compact arrays.  Constant
+  // mass and charge stay constant.
+  ChargedParticles Subset(const vtkm::cont::ArrayHandle<vtkm::Id>& indices) const
+  {
+    vtkm::Id numValues = indices.GetNumberOfValues();
+    auto gather = [&](const auto& values, auto& gathered) {
+      vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandlePermutation(indices, values), gathered);
+    };
+
+    ChargedParticles subset;
+    vtkm::cont::ArrayHandle<vtkm::Id> ids;
+    gather(this->Ids, ids);
+    subset.Ids = IdArrayType(ids);
+    for(vtkm::IdComponent component = 0; component < 3; component++)
+    {
+      ScalarArrayType position, momentum;
+      gather(this->Positions.GetArray(component), position);
+      gather(this->Momenta.GetArray(component), momentum);
+      subset.Positions.SetArray(component, position);
+      subset.Momenta.SetArray(component, momentum);
+    }
+    gather(this->Weighting, subset.Weighting);
+
+    auto gatherSpecies = [&](const SpeciesArrayType& values, bool constant, SpeciesArrayType& gathered) {
+      if(constant)
+      {
+        vtkm::FloatDefault value = numValues > 0 ? values.ReadPortal().Get(0) : 0;
+        gathered = SpeciesArrayType(vtkm::cont::make_ArrayHandleConstant(value, numValues));
+        return;
+      }
+      ScalarArrayType compact;
+      gather(values, compact);
+      gathered = SpeciesArrayType(compact);
+    };
+    gatherSpecies(this->Mass, this->ConstantMass, subset.Mass);
+    gatherSpecies(this->Charge, this->ConstantCharge, subset.Charge);
+    subset.ConstantMass = this->ConstantMass;
+    subset.ConstantCharge = this->ConstantCharge;
+    return subset;
+  }
+
+  // Builds the particles used for advection, with momenta in SI units.
+  void MakeChargedParticles(vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& particles) const
+  {
+    vtkm::cont::Invoker invoker;
+    invoker(detail::MakeChargedParticle{}, this->Ids, this->Positions, this->Momenta,
+            this->Mass, this->Charge, this->Weighting, particles);
+  }
+
+  // Momenta in SI units, as carried by vtkm::ChargedParticle.
+  void GetMomentaSI(vtkm::cont::ArrayHandle<vtkm::Vec3f>& momenta) const
+  {
+    vtkm::cont::Invoker invoker;
+    invoker(detail::MomentumToSI{}, this->Momenta, this->Mass, momenta);
+  }
+
+private:
+  // Replaces a per-particle array by a constant one when all values are
+  // equal.  Returns whether it did.
+  static bool Compress(const ScalarArrayType& values, SpeciesArrayType& compressed)
+  {
+    vtkm::Id numValues = values.GetNumberOfValues();
+    if(numValues > 0)
+    {
+      auto range = vtkm::cont::Algorithm::Reduce(
+        values, vtkm::Vec<vtkm::FloatDefault, 2>(values.ReadPortal().Get(0)), vtkm::MinAndMax<vtkm::FloatDefault>());
+      if(range[0] == range[1])
+      {
+        compressed = SpeciesArrayType(vtkm::cont::make_ArrayHandleConstant(range[0], numValues));
+        return true;
+      }
+    }
+    compressed = SpeciesArrayType(values);
+    return false;
+  }
+
+  IdArrayType Ids;
+  VectorArrayType Positions;
+  VectorArrayType Momenta;
+  SpeciesArrayType Mass;
+  SpeciesArrayType Charge;
+  ScalarArrayType Weighting;
+  bool ConstantMass;
+  bool ConstantCharge;
+};
+
+} // namespace seeding
+
+#endif
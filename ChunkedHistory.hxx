@@ -0,0 +1,458 @@
+#ifndef history_chunked_history_hxx
+#define history_chunked_history_hxx
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/ArrayHandleView.h>
+#include <vtkm/cont/AtomicArray.h>
+#include <vtkm/cont/ExecutionObjectBase.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include <vtkm/filter/flow/worklet/ParticleAdvectionWorklets.h>
+#include <vtkm/filter/flow/worklet/Particles.h>
+
+#include "Instrumentation.h"
+
+namespace history
+{
+
+/*
+ * Execution side of ChunkedStateRecordingParticles.  Every particle owns a
+ * linked list of fixed-size chunks in a shared point arena.  A particle
+ * starts with one chunk and takes a new one from the shared bump pointer
+ * when its current chunk is full.  When the arena is exhausted the step
+ * is dropped and the particle pauses until the host has grown the arena,
+ * so no recorded point is lost.
+ */
+template <typename ParticleType>
+class ChunkedStateRecordingParticleExecutionObject
+  : public vtkm::worklet::flow::ParticleExecutionObject<ParticleType>
+{
+public:
+  using Superclass = vtkm::worklet::flow::ParticleExecutionObject<ParticleType>;
+  using IdPortal = typename vtkm::cont::ArrayHandle<vtkm::Id>::WritePortalType;
+  using PointPortal = typename vtkm::cont::ArrayHandle<vtkm::Vec3f>::WritePortalType;
+  using CounterType = vtkm::exec::AtomicArrayExecutionObject<vtkm::Id>;
+
+  VTKM_EXEC_CONT
+  ChunkedStateRecordingParticleExecutionObject()
+  : Superclass()
+  , ChunkSize(0)
+  , Capacity(0)
+  {}
+
+  VTKM_CONT
+  ChunkedStateRecordingParticleExecutionObject(vtkm::cont::ArrayHandle<ParticleType> particles,
+                                               vtkm::Id maxSteps,
+                                               vtkm::cont::ArrayHandle<vtkm::Vec3f> points,
+                                               vtkm::cont::ArrayHandle<vtkm::Id> chunkNext,
+                                               vtkm::cont::ArrayHandle<vtkm::Id> tail,
+                                               vtkm::cont::ArrayHandle<vtkm::Id> count,
+                                               vtkm::cont::ArrayHandle<vtkm::Id> paused,
+                                               vtkm::cont::ArrayHandle<vtkm::Id> counter,
+                                               vtkm::Id chunkSize,
+                                               vtkm::Id capacity,
+                                               vtkm::cont::DeviceAdapterId device,
+                                               vtkm::cont::Token& token)
+  : Superclass(particles, maxSteps, device, token)
+  , Points(points.PrepareForInPlace(device, token))
+  , ChunkNext(chunkNext.PrepareForInPlace(device, token))
+  , Tail(tail.PrepareForInPlace(device, token))
+  , Count(count.PrepareForInPlace(device, token))
+  , Paused(paused.PrepareForInPlace(device, token))
+  , Counter(vtkm::cont::AtomicArray<vtkm::Id>(counter).PrepareForExecution(device, token))
+  , ChunkSize(chunkSize)
+  , Capacity(capacity)
+  {}
+
+  VTKM_EXEC
+  void PreStepUpdate(const vtkm::Id& idx)
+  {
+    Superclass::PreStepUpdate(idx);
+    if(this->Count.Get(idx) == 0)
+      this->Record(idx, this->GetParticle(idx).Pos);
+    // Resumed after the arena grew, the step dropped when pausing is
+    // taken again.
+    this->Paused.Set(idx, 0);
+  }
+
+  VTKM_EXEC
+  void StepUpdate(const vtkm::Id& idx,
+                  const ParticleType& particle,
+                  vtkm::FloatDefault time,
+                  const vtkm::Vec3f& pt)
+  {
+    // Without room for the point the step is dropped and the particle
+    // pauses until the host has grown the arena.
+    if(!this->Reserve(idx))
+      return;
+    Superclass::StepUpdate(idx, particle, time, pt);
+    this->Record(idx, pt);
+  }
+
+  VTKM_EXEC
+  bool CanContinue(const vtkm::Id& idx)
+  {
+    return this->Paused.Get(idx) == 0 && Superclass::CanContinue(idx);
+  }
+
+private:
+  VTKM_EXEC
+  void Record(const vtkm::Id& idx, const vtkm::Vec3f& pt)
+  {
+    vtkm::Id count = this->Count.Get(idx);
+    this->Points.Set(this->Tail.Get(idx) * this->ChunkSize + count % this->ChunkSize, pt);
+    this->Count.Set(idx, count + 1);
+  }
+
+  // Makes sure there is a slot for the next point of the particle, taking
+  // a new chunk from the arena once the current one is full.
+  VTKM_EXEC
+  bool Reserve(const vtkm::Id& idx)
+  {
+    if(this->Count.Get(idx) % this->ChunkSize != 0)
+      return true;
+    vtkm::Id chunk = this->Counter.Add(0, 1);
+    if(chunk >= this->Capacity)
+    {
+      this->Paused.Set(idx, 1);
+      return false;
+    }
+    this->ChunkNext.Set(this->Tail.Get(idx), chunk);
+    this->ChunkNext.Set(chunk, -1);
+    this->Tail.Set(idx, chunk);
+    return true;
+  }
+
+  PointPortal Points;
+  IdPortal ChunkNext;
+  IdPortal Tail;
+  IdPortal Count;
+  IdPortal Paused;
+  CounterType Counter;
+  vtkm::Id ChunkSize;
+  vtkm::Id Capacity;
+};
+
+namespace detail
+{
+
+class GatherHistory : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  GatherHistory(vtkm::Id chunkSize)
+  : ChunkSize(chunkSize)
+  {}
+
+  using ControlSignature = void(FieldIn head, FieldIn count, FieldIn offset,
+                                WholeArrayIn next, WholeArrayIn points, WholeArrayOut history);
+  using ExecutionSignature = void(_1, _2, _3, _4, _5, _6);
+
+  template <typename NextPortalType, typename PointPortalType, typename HistoryPortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id head,
+                  const vtkm::Id count,
+                  const vtkm::Id offset,
+                  const NextPortalType& next,
+                  const PointPortalType& points,
+                  HistoryPortalType& history) const
+  {
+    vtkm::Id chunk = head;
+    for(vtkm::Id point = 0; point < count; point++)
+    {
+      if(point > 0 && point % this->ChunkSize == 0)
+        chunk = next.Get(chunk);
+      history.Set(offset + point, points.Get(chunk * this->ChunkSize + point % this->ChunkSize));
+    }
+  }
+
+private:
+  vtkm::Id ChunkSize;
+};
+
+// Whether the advection worklet would move the particle any further.
+template <typename ParticleType>
+VTKM_EXEC_CONT bool CanMove(const ParticleType& p)
+{
+  return p.Status.CheckOk() && !p.Status.CheckTerminate() && !p.Status.CheckSpatialBounds() &&
+         !p.Status.CheckTemporalBounds() && !p.Status.CheckInGhostCell() &&
+         !p.Status.CheckZeroVelocity();
+}
+
+// Stops every particle that can still move after at most `numSteps` more
+// steps, and flags it for advection.
+class LimitSteps : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  LimitSteps(vtkm::Id numSteps, vtkm::Id maxSteps)
+  : NumSteps(numSteps)
+  , MaxSteps(maxSteps)
+  {}
+
+  using ControlSignature = void(FieldIn particle, FieldOut limit, FieldOut active);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename ParticleType>
+  VTKM_EXEC
+  void operator()(const ParticleType& p, vtkm::Id& limit, vtkm::UInt8& active) const
+  {
+    limit = vtkm::Min(p.NumSteps + this->NumSteps, this->MaxSteps);
+    active = CanMove(p);
+  }
+
+private:
+  vtkm::Id NumSteps;
+  vtkm::Id MaxSteps;
+};
+
+// Particles terminated by the limit of LimitSteps rather than by maxSteps
+// are free to move again.
+class ClearStepLimit : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  ClearStepLimit(vtkm::Id maxSteps)
+  : MaxSteps(maxSteps)
+  {}
+
+  using ControlSignature = void(FieldInOut particle);
+  using ExecutionSignature = void(_1);
+
+  template <typename ParticleType>
+  VTKM_EXEC
+  void operator()(ParticleType& p) const
+  {
+    if(p.Status.CheckTerminate() && p.NumSteps < this->MaxSteps)
+      p.Status.ClearTerminate();
+  }
+
+private:
+  vtkm::Id MaxSteps;
+};
+
+} // namespace detail
+
+/*
+ * Drop-in replacement for vtkm::worklet::flow::StateRecordingParticles
+ * whose history grows with the points actually produced instead of
+ * reserving maxSteps + 1 points for every particle up front.  Points are
+ * stored in chunks of ChunkSize handed out from a shared arena; Advect
+ * runs the advection worklet and grows the arena whenever particles ran
+ * out of chunks, resuming only those particles.
+ */
+template <typename ParticleType>
+class ChunkedStateRecordingParticles : public vtkm::cont::ExecutionObjectBase
+{
+public:
+  VTKM_CONT
+  ChunkedStateRecordingParticles(vtkm::cont::ArrayHandle<ParticleType>& particles,
+                                 vtkm::Id maxSteps,
+                                 vtkm::Id chunkSize = 64,
+                                 vtkm::Id chunksPerParticle = 2)
+  : Particles(particles)
+  , MaxSteps(maxSteps)
+  , ChunkSize(vtkm::Max(vtkm::Min(chunkSize, maxSteps + 1), vtkm::Id(1)))
+  {
+    vtkm::Id numParticles = particles.GetNumberOfValues();
+    // No particle records more than maxSteps + 1 points, so short runs
+    // get short chunks and never more of them than they can fill.
+    vtkm::Id maxChunks = (maxSteps + this->ChunkSize) / this->ChunkSize;
+    chunksPerParticle = vtkm::Min(chunksPerParticle, maxChunks);
+    // The first chunk of particle i is chunk i.
+    this->Capacity = vtkm::Max(numParticles * chunksPerParticle, vtkm::Id(1));
+    this->Points.Allocate(this->Capacity * this->ChunkSize);
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant(vtkm::Id(-1), this->Capacity), this->ChunkNext);
+    vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(numParticles), this->Head);
+    vtkm::cont::ArrayCopy(this->Head, this->Tail);
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant(vtkm::Id(0), numParticles), this->Count);
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant(vtkm::Id(0), numParticles), this->Paused);
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant(numParticles, 1), this->Counter);
+  }
+
+  VTKM_CONT
+  ChunkedStateRecordingParticleExecutionObject<ParticleType> PrepareForExecution(
+    vtkm::cont::DeviceAdapterId device,
+    vtkm::cont::Token& token) const
+  {
+    return ChunkedStateRecordingParticleExecutionObject<ParticleType>(
+      this->Particles, this->MaxSteps, this->Points, this->ChunkNext, this->Tail,
+      this->Count, this->Paused, this->Counter, this->ChunkSize, this->Capacity, device, token);
+  }
+
+  // Advects all particles with `stepper`, growing the arena as needed.
+  template <typename StepperType>
+  VTKM_CONT
+  void Advect(const StepperType& stepper)
+  {
+    vtkm::Id numParticles = this->Particles.GetNumberOfValues();
+    vtkm::cont::ArrayHandle<vtkm::Id> active;
+    vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(numParticles), active);
+    this->Run(stepper, active, vtkm::cont::make_ArrayHandleConstant(this->MaxSteps, numParticles));
+  }
+
+  // Advects the particles that can still move by at most `numSteps` more
+  // steps each, so that long runs can be split into segments.  Returns the
+  // number of particles advected.
+  template <typename StepperType>
+  VTKM_CONT
+  vtkm::Id AdvectSteps(const StepperType& stepper, vtkm::Id numSteps)
+  {
+    vtkm::cont::Invoker invoker;
+    vtkm::Id numParticles = this->Particles.GetNumberOfValues();
+    vtkm::cont::ArrayHandle<vtkm::Id> limits;
+    vtkm::cont::ArrayHandle<vtkm::UInt8> canMove;
+    invoker(detail::LimitSteps(numSteps, this->MaxSteps), this->Particles, limits, canMove);
+    // The advection worklet always tries one step, even for a stopped
+    // particle, so only the particles that can move are launched.
+    vtkm::cont::ArrayHandle<vtkm::Id> active;
+    {
+      instrumentation::Scope scope("Active CopyIf");
+      vtkm::cont::Algorithm::CopyIf(vtkm::cont::ArrayHandleIndex(numParticles), canMove, active);
+      scope.SetCount(numParticles);
+    }
+    vtkm::Id numActive = active.GetNumberOfValues();
+    this->Run(stepper, active, limits);
+    invoker(detail::ClearStepLimit(this->MaxSteps), this->Particles);
+    return numActive;
+  }
+
+  // Reorders the particles together with their histories : particle
+  // order[i] becomes particle i.  The particles are shared with the
+  // caller, so they are permuted in place.
+  VTKM_CONT
+  void Permute(const vtkm::cont::ArrayHandle<vtkm::Id>& order)
+  {
+    vtkm::cont::ArrayHandle<ParticleType> particles;
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandlePermutation(order, this->Particles), particles);
+    vtkm::cont::Algorithm::Copy(particles, this->Particles);
+    for(auto* values : { &this->Head, &this->Tail, &this->Count })
+    {
+      vtkm::cont::ArrayHandle<vtkm::Id> permuted;
+      vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandlePermutation(order, *values), permuted);
+      *values = permuted;
+    }
+  }
+
+  VTKM_CONT
+  const vtkm::cont::ArrayHandle<ParticleType>& GetParticles() const { return this->Particles; }
+
+  VTKM_CONT
+  vtkm::Id GetMaxSteps() const { return this->MaxSteps; }
+
+  // Points recorded for every particle, including its starting point.
+  VTKM_CONT
+  void GetNumberOfPoints(vtkm::cont::ArrayHandle<vtkm::Id>& numPoints) const
+  {
+    vtkm::cont::ArrayCopy(this->Count, numPoints);
+  }
+
+  // All recorded points, particle after particle.
+  VTKM_CONT
+  void GetCompactedHistory(vtkm::cont::ArrayHandle<vtkm::Vec3f>& positions) const
+  {
+    this->GetHistory(0, this->Particles.GetNumberOfValues(), positions);
+  }
+
+  // Points recorded for particles [first, first + numParticles), particle
+  // after particle.  Lets writers compact the history one range at a time.
+  VTKM_CONT
+  void GetHistory(vtkm::Id first,
+                  vtkm::Id numParticles,
+                  vtkm::cont::ArrayHandle<vtkm::Vec3f>& positions) const
+  {
+    instrumentation::Scope scope("History gather");
+    auto head = vtkm::cont::make_ArrayHandleView(this->Head, first, numParticles);
+    auto count = vtkm::cont::make_ArrayHandleView(this->Count, first, numParticles);
+    vtkm::cont::ArrayHandle<vtkm::Id> offsets;
+    vtkm::Id numPoints = vtkm::cont::Algorithm::ScanExclusive(count, offsets);
+    positions.Allocate(numPoints);
+    vtkm::cont::Invoker invoker;
+    invoker(detail::GatherHistory(this->ChunkSize), head, count, offsets,
+            this->ChunkNext, this->Points, positions);
+    scope.SetCount(numPoints);
+    scope.AddBytes(numPoints * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f)));
+  }
+
+  // Size of the arena, in points.
+  VTKM_CONT
+  vtkm::Id GetArenaSize() const { return this->Capacity * this->ChunkSize; }
+
+private:
+  // Runs the advection worklet on the `active` particles, particle i
+  // stopping after limits[i] steps, and resumes those that paused once the
+  // arena has grown.
+  template <typename StepperType, typename LimitArrayType>
+  VTKM_CONT
+  void Run(const StepperType& stepper,
+           vtkm::cont::ArrayHandle<vtkm::Id> active,
+           const LimitArrayType& limits)
+  {
+    vtkm::cont::Invoker invoker;
+    vtkm::Id numParticles = this->Particles.GetNumberOfValues();
+    while(active.GetNumberOfValues() > 0)
+    {
+      {
+        instrumentation::Scope scope("Advect");
+        scope.SetCount(active.GetNumberOfValues());
+        invoker(vtkm::worklet::flow::ParticleAdvectWorklet{}, active, stepper, *this,
+                vtkm::cont::make_ArrayHandlePermutation(active, limits));
+      }
+      {
+        instrumentation::Scope scope("Paused CopyIf");
+        scope.SetCount(numParticles);
+        vtkm::cont::Algorithm::CopyIf(vtkm::cont::ArrayHandleIndex(numParticles), this->Paused, active);
+      }
+      if(active.GetNumberOfValues() > 0)
+        this->Grow(active.GetNumberOfValues());
+    }
+  }
+
+  // Makes room for at least one more chunk for each paused particle.
+  VTKM_CONT
+  void Grow(vtkm::Id numPaused)
+  {
+    instrumentation::Scope scope("Arena grow");
+    vtkm::Id used = vtkm::Min(this->Counter.ReadPortal().Get(0), this->Capacity);
+    vtkm::Id capacity = vtkm::Max(2 * this->Capacity, used + numPaused);
+    scope.AddBytes((capacity - this->Capacity) *
+                   (this->ChunkSize * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f)) + static_cast<vtkm::Id>(sizeof(vtkm::Id))));
+    this->Capacity = capacity;
+    this->Points.Allocate(this->Capacity * this->ChunkSize, vtkm::CopyFlag::On);
+    this->ChunkNext.Allocate(this->Capacity, vtkm::CopyFlag::On);
+    this->Counter.WritePortal().Set(0, used);
+  }
+
+  vtkm::cont::ArrayHandle<ParticleType> Particles;
+  vtkm::Id MaxSteps;
+  vtkm::Id ChunkSize;
+  vtkm::Id Capacity;
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> Points;
+  vtkm::cont::ArrayHandle<vtkm::Id> ChunkNext;
+  vtkm::cont::ArrayHandle<vtkm::Id> Head;
+  vtkm::cont::ArrayHandle<vtkm::Id> Tail;
+  vtkm::cont::ArrayHandle<vtkm::Id> Count;
+  vtkm::cont::ArrayHandle<vtkm::Id> Paused;
+  vtkm::cont::ArrayHandle<vtkm::Id> Counter;
+};
+
+// Number of steps all particles took, i.e. the recorded points that are
+// not starting points.
+template <typename ParticleType>
+vtkm::Id CountSteps(const ParticleType& particles, vtkm::cont::ArrayHandle<vtkm::Id>& numPoints)
+{
+  particles.GetNumberOfPoints(numPoints);
+  return vtkm::cont::Algorithm::Reduce(numPoints, static_cast<vtkm::Id>(0)) - numPoints.GetNumberOfValues();
+}
+
+} // namespace history
+
+#endif
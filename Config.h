@@ -1,6 +1,9 @@
 #ifndef seeding_config_h
 #define seeding_config_h
 
+#include <string>
+#include <vector>
+
 #include <vtkm/Types.h>
 
 namespace config
@@ -12,12 +15,51 @@ enum class SeedingOption
   SINGLE  = 2,
 };
 
+enum class SamplingOption
+{
+  UNIFORM  = 0,
+  WEIGHTED = 1,
+};
+
+enum class StreamFormat
+{
+  VTK = 0,
+  RAW = 1,
+};
+
+enum class IntegratorOption
+{
+  RK4     = 0,
+  BORIS   = 1,
+  COMPARE = 2,
+};
+
+enum class PrecisionOption
+{
+  DOUBLE  = 0,
+  MIXED   = 1,
+  COMPARE = 2,
+};
+
 class Config
 {
 public:
   Config()
   : Option(SeedingOption::UNIFORM)
   , Dimensions(-1, -1, -1) // Force native resolution
+  , Sampling(SamplingOption::UNIFORM)
+  , SamplingSeed(314)
+  , Format(StreamFormat::VTK)
+  , Integrator(IntegratorOption::RK4)
+  , CflFactor(0.2)
+  , EvaluatorBenchmark(0)
+  , Precision(PrecisionOption::DOUBLE)
+  , ReorderInterval(-1) // No reordering
+  , ChunkSteps(0) // All steps in one launch
+  , Workers(0) // No scheduler benchmark
+  , Threads(0) // Backend default
+  , ScalingThreads(0) // No scaling sweep
+  , Verbose(false)
   {}
 
   void SetDataSetName(const std::string& dataSetName) {this->DataSetName = dataSetName;}
@@ -55,6 +97,79 @@ public:
 
   void SetThreshold(vtkm::FloatDefault threshold) {this->Threshold = threshold;}
   vtkm::FloatDefault GetThreshold() const {return this->Threshold;}
+
+  void SetSampling(SamplingOption sampling) {this->Sampling = sampling;}
+  SamplingOption GetSamplingOption() const {return this->Sampling;}
+
+  void SetSamplingSeed(vtkm::UInt32 seed) {this->SamplingSeed = seed;}
+  vtkm::UInt32 GetSamplingSeed() const {return this->SamplingSeed;}
+
+  void SetFieldFiles(const std::vector<std::string>& files) {this->FieldFiles = files;}
+  const std::vector<std::string>& GetFieldFiles() const {return this->FieldFiles;}
+
+  void SetFieldTimes(const std::vector<vtkm::FloatDefault>& times) {this->FieldTimes = times;}
+  const std::vector<vtkm::FloatDefault>& GetFieldTimes() const {return this->FieldTimes;}
+
+  bool IsTemporal() const {return this->FieldFiles.size() > 1;}
+
+  void SetBatchFiles(const std::vector<std::string>& fieldFiles,
+                     const std::vector<std::string>& seedFiles)
+  {
+    this->BatchFieldFiles = fieldFiles;
+    this->BatchSeedFiles = seedFiles;
+  }
+  const std::vector<std::string>& GetBatchFieldFiles() const {return this->BatchFieldFiles;}
+  const std::vector<std::string>& GetBatchSeedFiles() const {return this->BatchSeedFiles;}
+
+  bool IsBatch() const {return !this->BatchFieldFiles.empty();}
+
+  void SetStreamFormat(StreamFormat format) {this->Format = format;}
+  StreamFormat GetStreamFormat() const {return this->Format;}
+
+  void SetIntegrator(IntegratorOption integrator) {this->Integrator = integrator;}
+  IntegratorOption GetIntegratorOption() const {return this->Integrator;}
+
+  void SetCflFactor(vtkm::FloatDefault cflFactor) {this->CflFactor = cflFactor;}
+  vtkm::FloatDefault GetCflFactor() const {return this->CflFactor;}
+
+  void SetEvaluatorBenchmark(vtkm::Id numSamples) {this->EvaluatorBenchmark = numSamples;}
+  vtkm::Id GetEvaluatorBenchmark() const {return this->EvaluatorBenchmark;}
+
+  void SetPrecision(PrecisionOption precision) {this->Precision = precision;}
+  PrecisionOption GetPrecisionOption() const {return this->Precision;}
+
+  // 0 sorts the particles once before advection, n > 0 also every n steps.
+  void SetReorderInterval(vtkm::Id interval) {this->ReorderInterval = interval;}
+  vtkm::Id GetReorderInterval() const {return this->ReorderInterval;}
+  bool IsReordered() const {return this->ReorderInterval >= 0;}
+
+  void SetChunkSteps(vtkm::Id chunkSteps) {this->ChunkSteps = chunkSteps;}
+  vtkm::Id GetChunkSteps() const {return this->ChunkSteps;}
+
+  // Threads of the block scheduler benchmark, 0 to skip it.
+  void SetWorkers(vtkm::Id workers) {this->Workers = workers;}
+  vtkm::Id GetWorkers() const {return this->Workers;}
+
+  // Chrome trace of the instrumented stages, empty when not recording.
+  void SetTraceFile(const std::string& traceFile) {this->TraceFile = traceFile;}
+  std::string GetTraceFile() const {return this->TraceFile;}
+
+  // Device forced through the runtime device tracker, empty to keep the
+  // one VTK-m picks.
+  void SetDevice(const std::string& device) {this->Device = device;}
+  std::string GetDevice() const {return this->Device;}
+
+  // Threads of the device, 0 for the backend default.
+  void SetThreads(vtkm::Id threads) {this->Threads = threads;}
+  vtkm::Id GetThreads() const {return this->Threads;}
+
+  // Largest thread count of the scaling sweep, 0 to skip it.
+  void SetScalingThreads(vtkm::Id scalingThreads) {this->ScalingThreads = scalingThreads;}
+  vtkm::Id GetScalingThreads() const {return this->ScalingThreads;}
+
+  // Prints the diagnostics of instrumentation::Log.
+  void SetVerbose(bool verbose) {this->Verbose = verbose;}
+  bool IsVerbose() const {return this->Verbose;}
 private:
   std::string DataSetName;
   std::string FieldName;
@@ -68,6 +183,25 @@ private:
   vtkm::Id SeedCount;
   std::string SeedData;
   vtkm::FloatDefault Threshold;
+  SamplingOption Sampling;
+  vtkm::UInt32 SamplingSeed;
+  std::vector<std::string> FieldFiles;
+  std::vector<vtkm::FloatDefault> FieldTimes;
+  std::vector<std::string> BatchFieldFiles;
+  std::vector<std::string> BatchSeedFiles;
+  StreamFormat Format;
+  IntegratorOption Integrator;
+  vtkm::FloatDefault CflFactor;
+  vtkm::Id EvaluatorBenchmark;
+  PrecisionOption Precision;
+  vtkm::Id ReorderInterval;
+  vtkm::Id ChunkSteps;
+  vtkm::Id Workers;
+  std::string TraceFile;
+  std::string Device;
+  vtkm::Id Threads;
+  vtkm::Id ScalingThreads;
+  bool Verbose;
 };
 
 } //namespace seeding
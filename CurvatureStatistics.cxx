@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include <vtkm/BinaryOperators.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayPortalToIterators.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "CurvatureStatistics.h"
+
+namespace statistics
+{
+
+namespace detail
+{
+
+class BinValues : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  BinValues(vtkm::FloatDefault min, vtkm::FloatDefault max, vtkm::Id numBins)
+  : Min(min)
+  , Max(max)
+  , NumBins(numBins)
+  , Scale(static_cast<vtkm::FloatDefault>(numBins) / (max - min))
+  {
+  }
+
+  using ControlSignature = void(FieldIn, AtomicArrayInOut);
+  using ExecutionSignature = void(_1, _2);
+
+  template <typename HistogramType>
+  VTKM_EXEC
+  void operator()(const vtkm::FloatDefault& value,
+                  const HistogramType& histogram) const
+  {
+    histogram.Add(this->GetBin(value), static_cast<vtkm::Id>(1));
+  }
+
+  VTKM_EXEC_CONT
+  vtkm::Id GetBin(const vtkm::FloatDefault& value) const
+  {
+    if(!(value > this->Min))
+      return 0;
+    if(!(value < this->Max))
+      return this->NumBins - 1;
+    vtkm::Id bin = static_cast<vtkm::Id>((value - this->Min) * this->Scale);
+    return vtkm::Min(bin, this->NumBins - 1);
+  }
+
+private:
+  vtkm::FloatDefault Min;
+  vtkm::FloatDefault Max;
+  vtkm::Id NumBins;
+  vtkm::FloatDefault Scale;
+};
+
+class InBin : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  InBin(const BinValues& binner, vtkm::Id bin)
+  : Binner(binner)
+  , Bin(bin)
+  {
+  }
+
+  using ControlSignature = void(FieldIn, FieldOut);
+  using ExecutionSignature = void(_1, _2);
+
+  VTKM_EXEC
+  void operator()(const vtkm::FloatDefault& value, vtkm::UInt8& inBin) const
+  {
+    inBin = (this->Binner.GetBin(value) == this->Bin) ? 1 : 0;
+  }
+
+private:
+  BinValues Binner;
+  vtkm::Id Bin;
+};
+
+// Largest set of values that is selected on the host.
+constexpr vtkm::Id MaxHostValues = 1 << 16;
+
+// Resolves `ranks`, pairs of (percentile index, rank in `values`), into
+// `result`.  The values are binned over their range [min, max] and every
+// bin holding a rank is refined in turn, until it is small enough to be
+// selected on the host.  Each level splits off at least the min and the
+// max of its bin, so heavy tails that put nearly every value in one bin
+// only cost more levels, not a large host selection.
+void SelectRanks(const vtkm::cont::ArrayHandle<vtkm::FloatDefault>& values,
+                 vtkm::FloatDefault min,
+                 vtkm::FloatDefault max,
+                 const std::vector<std::pair<std::size_t, vtkm::Id>>& ranks,
+                 vtkm::Id numBins,
+                 std::vector<vtkm::FloatDefault>& result)
+{
+  if(!(max > min))
+  {
+    for(const auto& rank : ranks)
+      result[rank.first] = min;
+    return;
+  }
+
+  vtkm::Id numValues = values.GetNumberOfValues();
+  if(numValues <= MaxHostValues)
+  {
+    auto portal = values.ReadPortal();
+    std::vector<vtkm::FloatDefault> candidates(numValues);
+    for(vtkm::Id j = 0; j < numValues; j++)
+      candidates[j] = portal.Get(j);
+    for(const auto& rank : ranks)
+    {
+      std::nth_element(candidates.begin(), candidates.begin() + rank.second, candidates.end());
+      result[rank.first] = candidates[rank.second];
+    }
+    return;
+  }
+
+  vtkm::cont::Invoker invoker;
+  BinValues binner(min, max, numBins);
+  vtkm::cont::ArrayHandle<vtkm::Id> histogram;
+  vtkm::cont::Algorithm::Fill(histogram, static_cast<vtkm::Id>(0), numBins);
+  invoker(binner, values, histogram);
+
+  vtkm::cont::ArrayHandle<vtkm::Id> binStarts;
+  vtkm::cont::Algorithm::ScanExtended(histogram, binStarts);
+  auto startsPortal = binStarts.ReadPortal();
+
+  // Ranks landing in the same bin share its refinement.
+  std::map<vtkm::Id, std::vector<std::pair<std::size_t, vtkm::Id>>> bins;
+  for(const auto& rank : ranks)
+  {
+    vtkm::Id bin = std::upper_bound(vtkm::cont::ArrayPortalToIteratorBegin(startsPortal),
+                                    vtkm::cont::ArrayPortalToIteratorEnd(startsPortal),
+                                    rank.second) -
+                   vtkm::cont::ArrayPortalToIteratorBegin(startsPortal) - 1;
+    bins[bin].emplace_back(rank.first, rank.second - startsPortal.Get(bin));
+  }
+
+  for(const auto& bin : bins)
+  {
+    vtkm::cont::ArrayHandle<vtkm::UInt8> inBin;
+    invoker(InBin(binner, bin.first), values, inBin);
+    vtkm::cont::ArrayHandle<vtkm::FloatDefault> binValues;
+    vtkm::cont::Algorithm::CopyIf(values, inBin, binValues);
+
+    using RangeType = vtkm::Vec<vtkm::FloatDefault, 2>;
+    RangeType range = vtkm::cont::Algorithm::Reduce(binValues,
+      RangeType(vtkm::Infinity<vtkm::FloatDefault>(), vtkm::NegativeInfinity<vtkm::FloatDefault>()),
+      vtkm::MinAndMax<vtkm::FloatDefault>());
+    SelectRanks(binValues, range[0], range[1], bin.second, numBins, result);
+  }
+}
+
+} // namespace detail
+
+void ComputeCurvatureStatistics(const vtkm::cont::ArrayHandle<vtkm::FloatDefault>& values,
+                                const std::vector<vtkm::FloatDefault>& percentiles,
+                                CurvatureStatistics& result,
+                                vtkm::Id numBins)
+{
+  result.NumberOfValues = values.GetNumberOfValues();
+  result.Percentiles = percentiles;
+  result.Values.assign(percentiles.size(), vtkm::Nan<vtkm::FloatDefault>());
+  if(result.NumberOfValues == 0)
+    return;
+
+  using RangeType = vtkm::Vec<vtkm::FloatDefault, 2>;
+  RangeType range = vtkm::cont::Algorithm::Reduce(values,
+    RangeType(vtkm::Infinity<vtkm::FloatDefault>(), vtkm::NegativeInfinity<vtkm::FloatDefault>()),
+    vtkm::MinAndMax<vtkm::FloatDefault>());
+  result.Min = range[0];
+  result.Max = range[1];
+
+  std::vector<std::pair<std::size_t, vtkm::Id>> ranks;
+  for(std::size_t i = 0; i < percentiles.size(); i++)
+  {
+    vtkm::Id rank = static_cast<vtkm::Id>(percentiles[i] * (vtkm::FloatDefault(result.NumberOfValues)/100.));
+    ranks.emplace_back(i, vtkm::Max(vtkm::Id(0), vtkm::Min(rank, result.NumberOfValues - 1)));
+  }
+  detail::SelectRanks(values, result.Min, result.Max, ranks, numBins, result.Values);
+}
+
+} // namespace statistics
@@ -0,0 +1,51 @@
+#ifndef curvature_statistics_h
+#define curvature_statistics_h
+
+#include <vector>
+
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+
+#include <vtkm/cont/ArrayHandle.h>
+
+namespace statistics
+{
+
+// Summary of a per-streamline curvature array.
+// Percentiles are given in [0, 100] and index into the ascending order of
+// the values the same way the old sorted printout did, so percentile 90
+// is the value that only the top 10% of the streamlines exceed.
+struct CurvatureStatistics
+{
+  vtkm::Id NumberOfValues = 0;
+  vtkm::FloatDefault Min = 0.;
+  vtkm::FloatDefault Max = 0.;
+  std::vector<vtkm::FloatDefault> Percentiles;
+  std::vector<vtkm::FloatDefault> Values;
+
+  // Value of the requested percentile closest to `percentile`, NaN when
+  // none is within 1e-6.  Use Values[i] to look up Percentiles[i] directly.
+  vtkm::FloatDefault GetPercentile(vtkm::FloatDefault percentile) const
+  {
+    for(std::size_t i = 0; i < this->Percentiles.size(); i++)
+    {
+      if(vtkm::Abs(this->Percentiles[i] - percentile) <= static_cast<vtkm::FloatDefault>(1e-6))
+        return this->Values[i];
+    }
+    return vtkm::Nan<vtkm::FloatDefault>();
+  }
+};
+
+// Computes min, max and the requested percentiles of `values` without
+// sorting them.  A parallel histogram locates the bin holding each
+// requested rank, and that bin is binned again until at most 64K values
+// remain, which are pulled back and selected exactly with nth_element.
+// Results match indexing into the fully sorted array.
+void ComputeCurvatureStatistics(const vtkm::cont::ArrayHandle<vtkm::FloatDefault>& values,
+                                const std::vector<vtkm::FloatDefault>& percentiles,
+                                CurvatureStatistics& result,
+                                vtkm::Id numBins = 1024);
+
+} // namespace statistics
+
+#endif
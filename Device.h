@@ -0,0 +1,125 @@
+#ifndef device_h
+#define device_h
+
+#include <iostream>
+#include <string>
+
+#include <vtkm/List.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/DeviceAdapterList.h>
+#include <vtkm/cont/DeviceAdapterTag.h>
+#include <vtkm/cont/RuntimeDeviceInformation.h>
+#include <vtkm/cont/RuntimeDeviceTracker.h>
+
+/*
+ * Backend and thread count selection.  The runtime device tracker is per
+ * thread, so these apply to the calling thread, which is the main thread
+ * in every executable.  The block scheduler workers pin themselves to the
+ * serial device.
+ */
+namespace device
+{
+
+namespace detail
+{
+
+struct FirstDevice
+{
+  template <typename DeviceAdapter>
+  void operator()(DeviceAdapter device, vtkm::cont::DeviceAdapterId& id) const
+  {
+    if(id == vtkm::cont::DeviceAdapterTagUndefined{} && vtkm::cont::GetRuntimeDeviceTracker().CanRunOn(device))
+      id = device;
+  }
+};
+
+} // namespace detail
+
+// Device VTK-m schedules on from this thread : the first enabled device
+// in priority order, undefined if none is.
+inline vtkm::cont::DeviceAdapterId GetDevice()
+{
+  vtkm::cont::DeviceAdapterId id = vtkm::cont::DeviceAdapterTagUndefined{};
+  vtkm::ListForEach(detail::FirstDevice{}, VTKM_DEFAULT_DEVICE_ADAPTER_LIST{}, id);
+  return id;
+}
+
+// Threads the device runs with, 0 when it has no such setting.
+inline vtkm::Id GetThreads(vtkm::cont::DeviceAdapterId id)
+{
+  vtkm::Id threads = 0;
+  vtkm::cont::RuntimeDeviceInformation{}.GetRuntimeConfiguration(id).GetThreads(threads);
+  return threads;
+}
+
+// Sets the threads of the current device.  Fails on devices without a
+// thread count, such as serial.
+inline bool SetThreads(vtkm::Id threads)
+{
+  vtkm::cont::DeviceAdapterId id = GetDevice();
+  auto result = vtkm::cont::RuntimeDeviceInformation{}.GetRuntimeConfiguration(id).SetThreads(threads);
+  if(result != vtkm::cont::internal::RuntimeDeviceConfigReturnCode::SUCCESS)
+  {
+    std::cout << "Cannot run " << id.GetName() << " on " << threads << " threads" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Forces the backend picked with -DWARPXSTREAMS_DEVICE at configure time.
+// Without it VTK-m keeps choosing the first enabled device at runtime.
+inline void SelectBuildDevice()
+{
+#ifdef WARPXSTREAMS_DEVICE
+  vtkm::cont::GetRuntimeDeviceTracker().ForceDevice(vtkm::cont::make_DeviceAdapterId(WARPXSTREAMS_DEVICE));
+#endif
+}
+
+// Returns false for a name VTK-m does not know.  "any" resets to the
+// default device order.
+inline bool ParseDevice(const std::string& name, vtkm::cont::DeviceAdapterId& id)
+{
+  if(name == "any")
+  {
+    id = vtkm::cont::DeviceAdapterTagAny{};
+    return true;
+  }
+  id = vtkm::cont::make_DeviceAdapterId(name);
+  return id.IsValueValid();
+}
+
+// Applies the `device` and `threads` options : forces the named device,
+// empty keeping the current one, and sets its threads when `threads` > 0.
+// Returns false when the device is not enabled in this build of VTK-m or
+// does not take a thread count.
+inline bool SelectDevice(const std::string& name, vtkm::Id threads)
+{
+  if(!name.empty())
+  {
+    vtkm::cont::DeviceAdapterId id;
+    if(!ParseDevice(name, id))
+    {
+      std::cout << "Unknown device " << name << std::endl;
+      return false;
+    }
+    vtkm::cont::RuntimeDeviceTracker& tracker = vtkm::cont::GetRuntimeDeviceTracker();
+    if(id == vtkm::cont::DeviceAdapterTagAny{})
+      tracker.Reset();
+    else if(vtkm::cont::RuntimeDeviceInformation{}.Exists(id))
+      tracker.ForceDevice(id);
+    else
+    {
+      std::cout << "Device " << id.GetName() << " is not enabled" << std::endl;
+      return false;
+    }
+  }
+  if(threads > 0 && !SetThreads(threads))
+    return false;
+  vtkm::cont::DeviceAdapterId current = GetDevice();
+  std::cout << "Device : " << current.GetName() << ", " << GetThreads(current) << " threads" << std::endl;
+  return true;
+}
+
+} // namespace device
+
+#endif
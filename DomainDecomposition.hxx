@@ -0,0 +1,484 @@
+#ifndef distributed_domain_decomposition_hxx
+#define distributed_domain_decomposition_hxx
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Range.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleUniformPointCoordinates.h>
+#include <vtkm/cont/ArrayHandleView.h>
+#include <vtkm/cont/CellSetStructured.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/ErrorBadValue.h>
+#include <vtkm/io/ErrorIO.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "FieldSeries.hxx"
+#include "Instrumentation.h"
+#include "StreamlineWriter.hxx"
+
+/*
+ * Decomposition of a structured field grid into slabs of whole z planes,
+ * one per rank.  Neighbouring slabs share their boundary plane of points,
+ * so every cell belongs to exactly one slab and a slab evaluates the fields
+ * exactly as the full grid would.  A particle stepping off the side of its
+ * slab moves on to the neighbour owning its new position.
+ */
+namespace distributed
+{
+
+struct Slab
+{
+  // Point planes [FirstPlane, LastPlane] of the full grid.
+  vtkm::Id FirstPlane;
+  vtkm::Id LastPlane;
+  // Z extent of the slab.
+  vtkm::Range Z;
+};
+
+namespace detail
+{
+
+inline vtkm::Id3 GetPointDimensions(const vtkm::cont::DataSet& dataset)
+{
+  using Structured3DType = vtkm::cont::CellSetStructured<3>;
+  vtkm::cont::DynamicCellSet cells = dataset.GetCellSet();
+  return cells.Cast<Structured3DType>().GetPointDimensions();
+}
+
+// Rank owning the position of a particle that stopped at the side of its
+// slab, or -1 for a particle that stays : stopped for any other reason,
+// or gone out of the whole grid.
+class Destination : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  Destination(const vtkm::Bounds& bounds, vtkm::Id rank)
+  : Bounds(bounds)
+  , Rank(rank)
+  {}
+
+  using ControlSignature = void(FieldIn particle, WholeArrayIn slabs, FieldOut destination);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename ParticleType, typename SlabPortalType>
+  VTKM_EXEC
+  void operator()(const ParticleType& p, const SlabPortalType& slabs, vtkm::Id& destination) const
+  {
+    destination = -1;
+    if(!p.Status.CheckSpatialBounds() || p.Status.CheckTerminate() || !this->Bounds.Contains(p.Pos))
+      return;
+    for(vtkm::Id rank = 0; rank < slabs.GetNumberOfValues(); rank++)
+    {
+      if(rank != this->Rank && slabs.Get(rank).Contains(p.Pos[2]))
+      {
+        destination = rank;
+        return;
+      }
+    }
+  }
+
+private:
+  vtkm::Bounds Bounds;
+  vtkm::Id Rank;
+};
+
+// Slab holding the position of every particle.  Particles outside all
+// slabs go to the first one, where they stop at their first step as they
+// would on the full grid.
+class Owner : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn particle, WholeArrayIn slabs, FieldOut owner);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename ParticleType, typename SlabPortalType>
+  VTKM_EXEC void operator()(const ParticleType& p, const SlabPortalType& slabs, vtkm::Id& owner) const
+  {
+    owner = 0;
+    for(vtkm::Id rank = 0; rank < slabs.GetNumberOfValues(); rank++)
+    {
+      vtkm::Range z = slabs.Get(rank);
+      bool last = rank + 1 == slabs.GetNumberOfValues();
+      if(p.Pos[2] >= z.Min && (p.Pos[2] < z.Max || (last && p.Pos[2] <= z.Max)))
+      {
+        owner = rank;
+        return;
+      }
+    }
+  }
+};
+
+// Particles received from another rank carry on in their new slab.
+class Arrive : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldInOut particle);
+  using ExecutionSignature = void(_1);
+
+  template <typename ParticleType>
+  VTKM_EXEC
+  void operator()(ParticleType& p) const
+  {
+    p.Status.ClearSpatialBounds();
+    p.Status.SetOk();
+  }
+};
+
+} // namespace detail
+
+// Splits the cells of the grid along z into `numSlabs` slabs of nearly
+// equal thickness.  `planeZ(p)` is the z coordinate of point plane p.
+template <typename PlaneZType>
+std::vector<Slab> DecomposeSlabs(const vtkm::Id3& dims, vtkm::Id numSlabs, PlaneZType&& planeZ)
+{
+  vtkm::Id numCells = dims[2] - 1;
+  if(numSlabs > numCells)
+    throw vtkm::cont::ErrorBadValue("More slabs than cells along z");
+
+  std::vector<Slab> slabs(static_cast<std::size_t>(numSlabs));
+  for(vtkm::Id s = 0; s < numSlabs; s++)
+  {
+    Slab& slab = slabs[static_cast<std::size_t>(s)];
+    slab.FirstPlane = s * numCells / numSlabs;
+    slab.LastPlane = (s + 1) * numCells / numSlabs;
+    slab.Z = vtkm::Range(planeZ(slab.FirstPlane), planeZ(slab.LastPlane));
+  }
+  return slabs;
+}
+
+inline std::vector<Slab> DecomposeSlabs(const vtkm::cont::DataSet& dataset, vtkm::Id numSlabs)
+{
+  vtkm::Id3 dims = detail::GetPointDimensions(dataset);
+  auto coords = dataset.GetCoordinateSystem().GetDataAsMultiplexer().ReadPortal();
+  vtkm::Id planeSize = dims[0] * dims[1];
+  return DecomposeSlabs(dims, numSlabs, [&](vtkm::Id plane) { return coords.Get(plane * planeSize)[2]; });
+}
+
+// Z extent of every slab, as the slab table of detail::Destination.
+inline vtkm::cont::ArrayHandle<vtkm::Range> GetSlabRanges(const std::vector<Slab>& slabs)
+{
+  std::vector<vtkm::Range> ranges;
+  for(const auto& slab : slabs)
+    ranges.push_back(slab.Z);
+  return vtkm::cont::make_ArrayHandle(ranges, vtkm::CopyFlag::On);
+}
+
+// Copies the grid and fields of one slab.  Points of a z plane are
+// contiguous, so every array of the slab is a single range of the full one.
+inline temporal::FieldSnapshot ExtractSlab(const temporal::FieldSnapshot& fields, const Slab& slab)
+{
+  vtkm::Id3 dims = detail::GetPointDimensions(fields.DataSet);
+  vtkm::Id3 slabDims(dims[0], dims[1], slab.LastPlane - slab.FirstPlane + 1);
+  vtkm::Id first = slab.FirstPlane * dims[0] * dims[1];
+  vtkm::Id count = slabDims[0] * slabDims[1] * slabDims[2];
+  instrumentation::Scope scope("Field read");
+  scope.SetCount(count);
+  scope.AddBytes(2 * count * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f)));
+
+  temporal::FieldSnapshot extracted;
+  extracted.Time = fields.Time;
+  vtkm::cont::CellSetStructured<3> cells;
+  cells.SetPointDimensions(slabDims);
+  extracted.DataSet.SetCellSet(cells);
+
+  const vtkm::cont::CoordinateSystem& coords = fields.DataSet.GetCoordinateSystem();
+  if(coords.GetData().IsType<vtkm::cont::ArrayHandleUniformPointCoordinates>())
+  {
+    vtkm::cont::ArrayHandleUniformPointCoordinates uniform;
+    coords.GetData().AsArrayHandle(uniform);
+    auto portal = uniform.ReadPortal();
+    vtkm::Vec3f origin = portal.GetOrigin();
+    vtkm::Vec3f spacing = portal.GetSpacing();
+    origin[2] += static_cast<vtkm::FloatDefault>(slab.FirstPlane) * spacing[2];
+    extracted.DataSet.AddCoordinateSystem(vtkm::cont::CoordinateSystem(
+      coords.GetName(), vtkm::cont::ArrayHandleUniformPointCoordinates(slabDims, origin, spacing)));
+  }
+  else
+  {
+    vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleView(coords.GetDataAsMultiplexer(), first, count), points);
+    extracted.DataSet.AddCoordinateSystem(vtkm::cont::CoordinateSystem(coords.GetName(), points));
+  }
+
+  vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleView(fields.Electric, first, count), extracted.Electric);
+  vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleView(fields.Magnetic, first, count), extracted.Magnetic);
+  extracted.DataSet.AddPointField("E", extracted.Electric);
+  extracted.DataSet.AddPointField("B", extracted.Magnetic);
+  return extracted;
+}
+
+/*
+ * Header of a binary legacy VTK STRUCTURED_POINTS file, with the position
+ * of every point array in the file.  The point data of a z plane is
+ * contiguous in every array, so a slab is one range of each and can be
+ * read without loading the rest of the grid.
+ */
+struct StructuredPointsFile
+{
+  struct Array
+  {
+    vtkm::IdComponent NumberOfComponents;
+    std::size_t ComponentSize;
+    bool IsDouble;
+    std::streamoff Offset;
+  };
+
+  std::string FileName;
+  vtkm::Id3 Dimensions;
+  vtkm::Vec3f Origin;
+  vtkm::Vec3f Spacing;
+  std::vector<std::pair<std::string, Array>> PointArrays;
+
+  vtkm::Bounds GetBounds() const
+  {
+    vtkm::Vec3f last = this->Origin + this->Spacing * vtkm::Vec3f(this->Dimensions - vtkm::Id3(1));
+    return vtkm::Bounds(this->Origin, last);
+  }
+
+  const Array* FindArray(const std::string& name) const
+  {
+    for(const auto& array : this->PointArrays)
+    {
+      if(array.first == name)
+        return &array.second;
+    }
+    return nullptr;
+  }
+};
+
+namespace detail
+{
+
+inline std::size_t GetTypeSize(const std::string& type)
+{
+  if(type == "bit")
+    return 0;
+  if(type == "char" || type == "unsigned_char")
+    return 1;
+  if(type == "short" || type == "unsigned_short")
+    return 2;
+  if(type == "int" || type == "unsigned_int" || type == "float")
+    return 4;
+  return 8;
+}
+
+// Records an array starting at the current position and skips its data.
+inline bool SkipArray(std::ifstream& file,
+                      vtkm::Id numValues,
+                      vtkm::IdComponent numComponents,
+                      const std::string& type,
+                      StructuredPointsFile::Array& array)
+{
+  array.NumberOfComponents = numComponents;
+  array.ComponentSize = GetTypeSize(type);
+  array.IsDouble = type == "double";
+  array.Offset = file.tellg();
+  if(array.ComponentSize == 0)
+    return false;
+  file.seekg(static_cast<std::streamoff>(numValues * numComponents) * static_cast<std::streamoff>(array.ComponentSize),
+             std::ios::cur);
+  return static_cast<bool>(file);
+}
+
+} // namespace detail
+
+// Reads the header of `fileName`.  Returns false for anything but a binary
+// legacy VTK STRUCTURED_POINTS file it can index, ASCII files included.
+inline bool ReadStructuredPointsFile(const std::string& fileName, StructuredPointsFile& header)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  std::string line, keyword;
+  std::getline(file, line);
+  std::getline(file, line);
+  std::getline(file, line);
+  if(!file || line.compare(0, 6, "BINARY") != 0)
+    return false;
+  header.FileName = fileName;
+  header.PointArrays.clear();
+  bool structuredPoints = false;
+  vtkm::Id numValues = 0;
+  bool pointData = false;
+  while(file >> keyword)
+  {
+    if(keyword == "DATASET")
+    {
+      file >> keyword;
+      structuredPoints = keyword == "STRUCTURED_POINTS";
+    }
+    else if(keyword == "DIMENSIONS")
+      file >> header.Dimensions[0] >> header.Dimensions[1] >> header.Dimensions[2];
+    else if(keyword == "ORIGIN")
+      file >> header.Origin[0] >> header.Origin[1] >> header.Origin[2];
+    else if(keyword == "SPACING" || keyword == "ASPECT_RATIO")
+      file >> header.Spacing[0] >> header.Spacing[1] >> header.Spacing[2];
+    else if(keyword == "POINT_DATA" || keyword == "CELL_DATA")
+    {
+      file >> numValues;
+      pointData = keyword == "POINT_DATA";
+    }
+    else if(keyword == "METADATA")
+    {
+      // Runs until the next blank line.
+      std::getline(file, line);
+      while(std::getline(file, line) && !line.empty())
+        ;
+      continue;
+    }
+    else if(keyword == "SCALARS" || keyword == "VECTORS" || keyword == "NORMALS")
+    {
+      std::string name, type;
+      file >> name >> type;
+      vtkm::IdComponent numComponents = keyword == "SCALARS" ? 1 : 3;
+      std::getline(file, line);
+      if(keyword == "SCALARS")
+      {
+        std::istringstream rest(line);
+        rest >> numComponents;
+        if(!rest)
+          numComponents = 1;
+        std::getline(file, line); // LOOKUP_TABLE
+      }
+      StructuredPointsFile::Array array;
+      if(!detail::SkipArray(file, numValues, numComponents, type, array))
+        return false;
+      if(pointData)
+        header.PointArrays.emplace_back(name, array);
+      continue;
+    }
+    else if(keyword == "FIELD")
+    {
+      std::string name;
+      vtkm::Id numArrays;
+      file >> name >> numArrays;
+      for(vtkm::Id i = 0; i < numArrays; i++)
+      {
+        std::string arrayName, type;
+        vtkm::IdComponent numComponents;
+        vtkm::Id numTuples;
+        file >> arrayName >> numComponents >> numTuples >> type;
+        std::getline(file, line);
+        StructuredPointsFile::Array array;
+        if(!detail::SkipArray(file, numTuples, numComponents, type, array))
+          return false;
+        if(pointData)
+          header.PointArrays.emplace_back(arrayName, array);
+        // Optional METADATA block of the array.
+        std::streampos next = file.tellg();
+        if(file >> keyword && keyword == "METADATA")
+        {
+          std::getline(file, line);
+          while(std::getline(file, line) && !line.empty())
+            ;
+        }
+        else
+        {
+          file.clear();
+          file.seekg(next);
+        }
+      }
+      continue;
+    }
+    else
+      return false;
+    std::getline(file, line);
+  }
+  return structuredPoints && numValues > 0 && header.Dimensions[2] > 1;
+}
+
+namespace detail
+{
+
+// Reads `count` big-endian vectors of `array` starting at point `first`.
+inline void ReadVectors(const StructuredPointsFile& header,
+                        const std::string& name,
+                        vtkm::Id first,
+                        vtkm::Id count,
+                        vtkm::cont::ArrayHandle<vtkm::Vec3f>& vectors)
+{
+  const StructuredPointsFile::Array* array = header.FindArray(name);
+  if(array == nullptr || array->NumberOfComponents != 3 || (array->ComponentSize != 4 && array->ComponentSize != 8))
+    throw vtkm::io::ErrorIO("No float or double vector field " + name + " in " + header.FileName);
+
+  std::vector<char> bytes(static_cast<std::size_t>(count) * 3 * array->ComponentSize);
+  std::ifstream file(header.FileName, std::ios::binary);
+  file.seekg(array->Offset + static_cast<std::streamoff>(first) * 3 * static_cast<std::streamoff>(array->ComponentSize));
+  file.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  if(!file)
+    throw vtkm::io::ErrorIO("Could not read " + name + " from " + header.FileName);
+
+  bool swap = streams::detail::IsLittleEndian();
+  vectors.Allocate(count);
+  auto portal = vectors.WritePortal();
+  const char* in = bytes.data();
+  for(vtkm::Id i = 0; i < count; i++)
+  {
+    vtkm::Vec3f vector;
+    for(vtkm::IdComponent c = 0; c < 3; c++, in += array->ComponentSize)
+    {
+      if(array->IsDouble)
+      {
+        vtkm::Float64 value;
+        memcpy(&value, in, sizeof(value));
+        vector[c] = static_cast<vtkm::FloatDefault>(swap ? streams::detail::SwapBytes(value) : value);
+      }
+      else
+      {
+        vtkm::Float32 value;
+        memcpy(&value, in, sizeof(value));
+        vector[c] = static_cast<vtkm::FloatDefault>(swap ? streams::detail::SwapBytes(value) : value);
+      }
+    }
+    portal.Set(i, vector);
+  }
+}
+
+} // namespace detail
+
+inline std::vector<Slab> DecomposeSlabs(const StructuredPointsFile& header, vtkm::Id numSlabs)
+{
+  return DecomposeSlabs(header.Dimensions, numSlabs, [&](vtkm::Id plane) {
+    return header.Origin[2] + static_cast<vtkm::FloatDefault>(plane) * header.Spacing[2];
+  });
+}
+
+// Reads the grid and the E and B fields of one slab, and nothing else.
+inline temporal::FieldSnapshot ReadSlab(const StructuredPointsFile& header, const Slab& slab)
+{
+  vtkm::Id3 dims = header.Dimensions;
+  vtkm::Id3 slabDims(dims[0], dims[1], slab.LastPlane - slab.FirstPlane + 1);
+  vtkm::Id first = slab.FirstPlane * dims[0] * dims[1];
+  vtkm::Id count = slabDims[0] * slabDims[1] * slabDims[2];
+  instrumentation::Scope scope("Field read");
+  scope.SetCount(count);
+  scope.AddBytes(2 * count * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f)));
+
+  temporal::FieldSnapshot extracted;
+  extracted.Time = 0;
+  vtkm::cont::CellSetStructured<3> cells;
+  cells.SetPointDimensions(slabDims);
+  extracted.DataSet.SetCellSet(cells);
+  vtkm::Vec3f origin = header.Origin;
+  origin[2] += static_cast<vtkm::FloatDefault>(slab.FirstPlane) * header.Spacing[2];
+  extracted.DataSet.AddCoordinateSystem(vtkm::cont::CoordinateSystem(
+    "coordinates", vtkm::cont::ArrayHandleUniformPointCoordinates(slabDims, origin, header.Spacing)));
+
+  detail::ReadVectors(header, "E", first, count, extracted.Electric);
+  detail::ReadVectors(header, "B", first, count, extracted.Magnetic);
+  extracted.DataSet.AddPointField("E", extracted.Electric);
+  extracted.DataSet.AddPointField("B", extracted.Magnetic);
+  return extracted;
+}
+
+} // namespace distributed
+
+#endif
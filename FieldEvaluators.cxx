@@ -0,0 +1,15 @@
+#include "FieldEvaluators.hxx"
+
+template class history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>;
+template void history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::Advect(
+  const integration::RK4Stepper<integration::UniformGridEvaluator>&);
+template void history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::Advect(
+  const integration::RK4Stepper<integration::MixedUniformGridEvaluator>&);
+template void history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::Advect(
+  const integration::RK4Stepper<integration::GenericEvaluatorType>&);
+template vtkm::Id history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::AdvectSteps(
+  const integration::RK4Stepper<integration::UniformGridEvaluator>&, vtkm::Id);
+template vtkm::Id history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::AdvectSteps(
+  const integration::RK4Stepper<integration::MixedUniformGridEvaluator>&, vtkm::Id);
+template vtkm::Id history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::AdvectSteps(
+  const integration::RK4Stepper<integration::GenericEvaluatorType>&, vtkm::Id);
@@ -0,0 +1,228 @@
+#ifndef integration_field_evaluators_hxx
+#define integration_field_evaluators_hxx
+
+#include <iostream>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Particle.h>
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/VecVariable.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/CellSetStructured.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/ExecutionObjectBase.h>
+
+#include <vtkm/filter/flow/worklet/Field.h>
+#include <vtkm/filter/flow/worklet/GridEvaluatorStatus.h>
+#include <vtkm/filter/flow/worklet/GridEvaluators.h>
+#include <vtkm/filter/flow/worklet/RK4Integrator.h>
+#include <vtkm/filter/flow/worklet/Stepper.h>
+
+#include "ChunkedHistory.hxx"
+#include "FieldSeries.hxx"
+#include "Instrumentation.h"
+#include "UniformGridEvaluator.hxx"
+
+namespace integration
+{
+
+// Grid spacing of the field dataset.
+inline vtkm::Vec3f ComputeSpacing(const vtkm::cont::DataSet& dataset)
+{
+  vtkm::cont::DynamicCellSet cells = dataset.GetCellSet();
+  auto bounds = dataset.GetCoordinateSystem().GetBounds();
+  instrumentation::Log() << "Bounds : " << bounds << std::endl;
+  using Structured3DType = vtkm::cont::CellSetStructured<3>;
+  Structured3DType castedCells = cells.Cast<Structured3DType>();
+  auto dims = castedCells.GetSchedulingRange(vtkm::TopologyElementTagPoint());
+  vtkm::Vec3f spacing = {bounds.X.Length() / (dims[0] - 1),
+                         bounds.Y.Length() / (dims[1] - 1),
+                         bounds.Z.Length() / (dims[2] - 1)};
+  instrumentation::Log() << "Spacing : " << spacing << std::endl;
+  return spacing;
+}
+
+// CFL limited step length for the grid of the field dataset.
+inline vtkm::FloatDefault ComputeStepLength(const vtkm::cont::DataSet& dataset)
+{
+  vtkm::Vec3f spacing = ComputeSpacing(dataset);
+  constexpr static vtkm::FloatDefault SPEED_OF_LIGHT =
+    static_cast<vtkm::FloatDefault>(2.99792458e8);
+  spacing = spacing * spacing;
+  vtkm::FloatDefault length =
+    1.0 / (SPEED_OF_LIGHT * vtkm::Sqrt(1./spacing[0] + 1./spacing[1] + 1./spacing[2]));
+  instrumentation::Log() << "CFL length : " << length << std::endl;
+  return length;
+}
+
+using FieldType = vtkm::worklet::flow::ElectroMagneticField<vtkm::cont::ArrayHandle<vtkm::Vec3f>>;
+using GenericEvaluatorType = vtkm::worklet::flow::GridEvaluator<FieldType>;
+
+template <typename EvaluatorType>
+using RK4Stepper =
+  vtkm::worklet::flow::Stepper<vtkm::worklet::flow::RK4Integrator<EvaluatorType>, EvaluatorType>;
+
+// Calls `functor` with an evaluator for the fields : the uniform grid
+// evaluator when the coordinates are uniform, the generic one otherwise.
+// With `mixed`, the uniform grid evaluator stores the fields in Float32.
+template <typename Functor>
+void DispatchEvaluator(const temporal::FieldSnapshot& fields, bool mixed, Functor&& functor)
+{
+  const vtkm::cont::CoordinateSystem& coords = fields.DataSet.GetCoordinateSystem();
+  if(integration::UniformGridEvaluator::CanEvaluate(coords))
+  {
+    if(mixed)
+    {
+      instrumentation::Log() << "Evaluator : uniform, Float32 fields" << std::endl;
+      functor(integration::MixedUniformGridEvaluator(coords, fields.Electric, fields.Magnetic));
+      return;
+    }
+    instrumentation::Log() << "Evaluator : uniform" << std::endl;
+    functor(integration::UniformGridEvaluator(coords, fields.Electric, fields.Magnetic));
+    return;
+  }
+  if(mixed)
+    instrumentation::Log() << "Mixed precision needs a uniform grid, fields stay in double" << std::endl;
+  instrumentation::Log() << "Evaluator : generic" << std::endl;
+  functor(GenericEvaluatorType(coords, fields.DataSet.GetCellSet(), FieldType(fields.Electric, fields.Magnetic)));
+}
+
+/*
+ * DispatchEvaluator for a series of snapshots.  The uniform grid
+ * evaluators are kept from one call to the next, so a new snapshot only
+ * interleaves its fields into the buffer of the previous one instead of
+ * building a new evaluator.  Other grids go through DispatchEvaluator.
+ */
+class CachedEvaluator
+{
+public:
+  template <typename Functor>
+  void Dispatch(const temporal::FieldSnapshot& fields, bool mixed, Functor&& functor)
+  {
+    const vtkm::cont::CoordinateSystem& coords = fields.DataSet.GetCoordinateSystem();
+    if(!integration::UniformGridEvaluator::CanEvaluate(coords))
+    {
+      DispatchEvaluator(fields, mixed, functor);
+      return;
+    }
+    if(mixed)
+    {
+      this->Mixed.Update(coords, fields.Electric, fields.Magnetic);
+      functor(static_cast<const integration::MixedUniformGridEvaluator&>(this->Mixed));
+      return;
+    }
+    this->Uniform.Update(coords, fields.Electric, fields.Magnetic);
+    functor(static_cast<const integration::UniformGridEvaluator&>(this->Uniform));
+  }
+
+private:
+  integration::UniformGridEvaluator Uniform;
+  integration::MixedUniformGridEvaluator Mixed;
+};
+
+// Execution side of BlockEvaluator.
+template <typename ExecEvaluatorType>
+class ExecutionBlockEvaluator
+{
+public:
+  using StatusType = vtkm::worklet::flow::GridEvaluatorStatus;
+
+  VTKM_EXEC_CONT
+  ExecutionBlockEvaluator() = default;
+
+  VTKM_CONT
+  ExecutionBlockEvaluator(const ExecEvaluatorType& evaluator, const vtkm::Bounds& bounds)
+  : Evaluator(evaluator)
+  , Bounds(bounds)
+  {}
+
+  template <typename Point>
+  VTKM_EXEC bool IsWithinSpatialBoundary(const Point& point) const
+  {
+    return this->Bounds.Contains(point) && this->Evaluator.IsWithinSpatialBoundary(point);
+  }
+
+  VTKM_EXEC
+  bool IsWithinTemporalBoundary(const vtkm::FloatDefault& time) const
+  {
+    return this->Evaluator.IsWithinTemporalBoundary(time);
+  }
+
+  VTKM_EXEC
+  vtkm::Bounds GetSpatialBoundary() const { return this->Bounds; }
+
+  VTKM_EXEC_CONT
+  vtkm::FloatDefault GetTemporalBoundary(vtkm::Id direction) const
+  {
+    return this->Evaluator.GetTemporalBoundary(direction);
+  }
+
+  template <typename Point>
+  VTKM_EXEC StatusType Evaluate(const Point& point,
+                                const vtkm::FloatDefault& time,
+                                vtkm::VecVariable<vtkm::Vec3f, 2>& out) const
+  {
+    if(!this->Bounds.Contains(point))
+    {
+      StatusType status;
+      status.SetFail();
+      status.SetSpatialBounds();
+      return status;
+    }
+    return this->Evaluator.Evaluate(point, time, out);
+  }
+
+private:
+  ExecEvaluatorType Evaluator;
+  vtkm::Bounds Bounds;
+};
+
+/*
+ * Restricts an evaluator to a block of its grid : points outside `bounds`
+ * are out of bounds, so particles stop on the side of the block, just past
+ * it, as they would at the side of the grid.  The fields are shared with
+ * the wrapped evaluator, not copied.
+ */
+template <typename EvaluatorType>
+class BlockEvaluator : public vtkm::cont::ExecutionObjectBase
+{
+public:
+  VTKM_CONT
+  BlockEvaluator(const EvaluatorType& evaluator, const vtkm::Bounds& bounds)
+  : Evaluator(evaluator)
+  , Bounds(bounds)
+  {}
+
+  VTKM_CONT
+  auto PrepareForExecution(vtkm::cont::DeviceAdapterId device, vtkm::cont::Token& token) const
+  {
+    auto evaluator = this->Evaluator.PrepareForExecution(device, token);
+    return ExecutionBlockEvaluator<decltype(evaluator)>(evaluator, this->Bounds);
+  }
+
+private:
+  EvaluatorType Evaluator;
+  vtkm::Bounds Bounds;
+};
+
+} // namespace integration
+
+// The RK4 advection of charged particles over each evaluator is compiled
+// once, in FieldEvaluators.cxx, rather than in every executable.
+extern template class history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>;
+extern template void history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::Advect(
+  const integration::RK4Stepper<integration::UniformGridEvaluator>&);
+extern template void history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::Advect(
+  const integration::RK4Stepper<integration::MixedUniformGridEvaluator>&);
+extern template void history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::Advect(
+  const integration::RK4Stepper<integration::GenericEvaluatorType>&);
+extern template vtkm::Id history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::AdvectSteps(
+  const integration::RK4Stepper<integration::UniformGridEvaluator>&, vtkm::Id);
+extern template vtkm::Id history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::AdvectSteps(
+  const integration::RK4Stepper<integration::MixedUniformGridEvaluator>&, vtkm::Id);
+extern template vtkm::Id history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>::AdvectSteps(
+  const integration::RK4Stepper<integration::GenericEvaluatorType>&, vtkm::Id);
+
+#endif
@@ -0,0 +1,34 @@
+#include <iostream>
+
+#include <vtkm/io/VTKDataSetReader.h>
+
+#include "FieldSeries.hxx"
+#include "Instrumentation.h"
+
+namespace temporal
+{
+
+FieldSnapshot LoadFieldSnapshot(const std::string& fileName, vtkm::FloatDefault time)
+{
+  instrumentation::Scope scope("Field read");
+  FieldSnapshot snapshot;
+  vtkm::io::VTKDataSetReader reader(fileName);
+  snapshot.DataSet = reader.ReadDataSet();
+  snapshot.Time = time;
+  snapshot.DataSet.GetField("E").GetData().AsArrayHandle(snapshot.Electric);
+  snapshot.DataSet.GetField("B").GetData().AsArrayHandle(snapshot.Magnetic);
+  scope.SetCount(snapshot.Electric.GetNumberOfValues());
+  scope.AddBytes(2 * snapshot.Electric.GetNumberOfValues() * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f)));
+  return snapshot;
+}
+
+void PrintOverlap(const AsyncFieldLoader& loader)
+{
+  vtkm::Float64 read = loader.GetReadTime();
+  vtkm::Float64 hidden = loader.GetHiddenTime();
+  std::ostream& log = instrumentation::Log();
+  log << "I/O (hidden/exposed) : " << hidden << " / " << loader.GetExposedTime() << std::endl;
+  log << "I/O overlap : " << (read > 0 ? 100. * hidden / read : 0.) << "%" << std::endl;
+}
+
+} // namespace temporal
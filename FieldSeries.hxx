@@ -0,0 +1,270 @@
+#ifndef temporal_field_series_hxx
+#define temporal_field_series_hxx
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/DeviceAdapterTag.h>
+#include <vtkm/cont/Timer.h>
+
+namespace temporal
+{
+
+// One WarpX field iteration and the simulation time it belongs to.
+struct FieldSnapshot
+{
+  vtkm::cont::DataSet DataSet;
+  vtkm::FloatDefault Time;
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> Electric;
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> Magnetic;
+};
+
+FieldSnapshot LoadFieldSnapshot(const std::string& fileName, vtkm::FloatDefault time);
+
+/*
+ * Reads field snapshots on a dedicated I/O thread.  Requests are served in
+ * order into a fixed pool of slots, so at most `poolSize` snapshots are
+ * resident at any time: the thread only starts a read once a slot has been
+ * released.  A slot drops the arrays of the snapshot it held before it is
+ * reused, since VTKDataSetReader always decodes into fresh arrays.
+ *
+ * Every read is timed on the I/O thread and every wait in Acquire on the
+ * calling thread.  The difference is the read time hidden behind compute.
+ */
+class AsyncFieldLoader
+{
+public:
+  AsyncFieldLoader(std::size_t poolSize = 3)
+  : Slots(poolSize)
+  , Done(false)
+  , ReadTime(0)
+  , ExposedTime(0)
+  {
+    for(std::size_t slot = 0; slot < poolSize; slot++)
+      this->FreeSlots.push_back(slot);
+    this->Worker = std::thread(&AsyncFieldLoader::Run, this);
+  }
+
+  ~AsyncFieldLoader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Done = true;
+    }
+    this->Condition.notify_all();
+    this->Worker.join();
+  }
+
+  AsyncFieldLoader(const AsyncFieldLoader&) = delete;
+  AsyncFieldLoader& operator=(const AsyncFieldLoader&) = delete;
+
+  // Queues a snapshot for reading.
+  void Request(const std::string& fileName, vtkm::FloatDefault time)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Pending.push_back({ fileName, time });
+    }
+    this->Condition.notify_all();
+  }
+
+  // Waits for the oldest requested snapshot and returns the slot holding
+  // it.  Errors raised by the reader are rethrown here.
+  std::size_t Acquire()
+  {
+    vtkm::cont::Timer timer{ vtkm::cont::DeviceAdapterTagSerial() };
+    timer.Start();
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    this->Condition.wait(lock, [this] { return !this->Ready.empty(); });
+    timer.Stop();
+    this->ExposedTime += timer.GetElapsedTime();
+
+    std::size_t slot = this->Ready.front();
+    this->Ready.pop_front();
+    if(this->Slots[slot].Error)
+    {
+      std::exception_ptr error = this->Slots[slot].Error;
+      this->Slots[slot].Error = nullptr;
+      this->FreeSlots.push_back(slot);
+      lock.unlock();
+      this->Condition.notify_all();
+      std::rethrow_exception(error);
+    }
+    return slot;
+  }
+
+  const FieldSnapshot& Get(std::size_t slot) const { return this->Slots[slot].Snapshot; }
+
+  // Hands a slot back to the pool once its snapshot is no longer needed.
+  void Release(std::size_t slot)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Slots[slot].Snapshot = FieldSnapshot();
+      this->FreeSlots.push_back(slot);
+    }
+    this->Condition.notify_all();
+  }
+
+  vtkm::Float64 GetReadTime() const
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    return this->ReadTime;
+  }
+
+  // Time the caller spent blocked on reads.
+  vtkm::Float64 GetExposedTime() const
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    return this->ExposedTime;
+  }
+
+  // Read time that overlapped with work on the calling thread.
+  vtkm::Float64 GetHiddenTime() const
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    return vtkm::Max(this->ReadTime - this->ExposedTime, vtkm::Float64(0));
+  }
+
+private:
+  struct FieldRequest
+  {
+    std::string FileName;
+    vtkm::FloatDefault Time;
+  };
+
+  struct Slot
+  {
+    FieldSnapshot Snapshot;
+    std::exception_ptr Error;
+  };
+
+  void Run()
+  {
+    while(true)
+    {
+      FieldRequest request;
+      std::size_t slot;
+      {
+        std::unique_lock<std::mutex> lock(this->Mutex);
+        this->Condition.wait(lock, [this] {
+          return this->Done || (!this->Pending.empty() && !this->FreeSlots.empty());
+        });
+        if(this->Done)
+          return;
+        request = this->Pending.front();
+        this->Pending.pop_front();
+        slot = this->FreeSlots.front();
+        this->FreeSlots.pop_front();
+      }
+
+      vtkm::cont::Timer timer{ vtkm::cont::DeviceAdapterTagSerial() };
+      timer.Start();
+      FieldSnapshot snapshot;
+      std::exception_ptr error;
+      try
+      {
+        snapshot = LoadFieldSnapshot(request.FileName, request.Time);
+      }
+      catch(...)
+      {
+        error = std::current_exception();
+      }
+      timer.Stop();
+
+      {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        this->Slots[slot].Snapshot = std::move(snapshot);
+        this->Slots[slot].Error = error;
+        this->ReadTime += timer.GetElapsedTime();
+        this->Ready.push_back(slot);
+      }
+      this->Condition.notify_all();
+    }
+  }
+
+  std::vector<Slot> Slots;
+  std::deque<std::size_t> FreeSlots;
+  std::deque<std::size_t> Ready;
+  std::deque<FieldRequest> Pending;
+  bool Done;
+  vtkm::Float64 ReadTime;
+  vtkm::Float64 ExposedTime;
+  mutable std::mutex Mutex;
+  std::condition_variable Condition;
+  std::thread Worker;
+};
+
+/*
+ * Sliding window over a time series of field snapshots.  Only the two
+ * snapshots bounding the current interval are held, while the loader
+ * reads the one after them, so at most three snapshots are in memory at
+ * any time, whatever the length of the series.
+ */
+class FieldWindow
+{
+public:
+  FieldWindow(const std::vector<std::string>& files,
+              const std::vector<vtkm::FloatDefault>& times)
+  : Files(files)
+  , Times(times)
+  , Current(0)
+  , Loader(3)
+  {
+    for(std::size_t index = 0; index < 3 && index < this->Files.size(); index++)
+      this->Loader.Request(this->Files[index], this->Times[index]);
+    this->First = this->Loader.Acquire();
+    this->Second = this->Loader.Acquire();
+  }
+
+  FieldWindow(const FieldWindow&) = delete;
+  FieldWindow& operator=(const FieldWindow&) = delete;
+
+  vtkm::Id GetNumberOfIntervals() const { return static_cast<vtkm::Id>(this->Files.size()) - 1; }
+  vtkm::Id GetCurrentInterval() const { return static_cast<vtkm::Id>(this->Current); }
+
+  const FieldSnapshot& GetFirst() const { return this->Loader.Get(this->First); }
+  const FieldSnapshot& GetSecond() const { return this->Loader.Get(this->Second); }
+
+  const AsyncFieldLoader& GetLoader() const { return this->Loader; }
+
+  // Moves the window to the next interval, dropping the oldest snapshot.
+  // Returns false once the last interval has been reached.
+  bool Advance()
+  {
+    if(this->Current + 2 >= this->Files.size())
+      return false;
+    this->Loader.Release(this->First);
+    this->First = this->Second;
+    this->Second = this->Loader.Acquire();
+    this->Current++;
+    if(this->Current + 2 < this->Files.size())
+      this->Loader.Request(this->Files[this->Current + 2], this->Times[this->Current + 2]);
+    return true;
+  }
+
+private:
+  std::vector<std::string> Files;
+  std::vector<vtkm::FloatDefault> Times;
+  std::size_t Current;
+  AsyncFieldLoader Loader;
+  std::size_t First;
+  std::size_t Second;
+};
+
+// Prints how much of the field reading was overlapped with compute.
+void PrintOverlap(const AsyncFieldLoader& loader);
+
+} // namespace temporal
+
+#endif
@@ -0,0 +1,8 @@
+#include "FilterStreamlines.h"
+
+template vtkm::cont::DataSet FilterStreamLines<detail::CurvatureMetric::SUM>(
+  const vtkm::cont::DataSet&, const vtkm::FloatDefault&, statistics::CurvatureStatistics&);
+template vtkm::cont::DataSet FilterStreamLines<detail::CurvatureMetric::SUM>(
+  const vtkm::cont::DataSet&, const vtkm::FloatDefault&);
+template vtkm::cont::DataSet FilterStreamLinesFused<detail::CurvatureMetric::SUM>(
+  const vtkm::cont::DataSet&, const vtkm::FloatDefault&, statistics::CurvatureStatistics&);
@@ -1,65 +1,137 @@
+#ifndef filter_streamlines_h
+#define filter_streamlines_h
+
+#include <iostream>
+
 #include <vtkm/Types.h>
 #include <vtkm/Math.h>
 
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandleView.h>
 #include <vtkm/cont/Invoker.h>
 
 #include <vtkm/worklet/WorkletMapField.h>
 #include <vtkm/worklet/WorkletMapTopology.h>
 
+#include "CurvatureStatistics.h"
+#include "Instrumentation.h"
+
 namespace detail
 {
 
-class AngularEntropy : public vtkm::worklet::WorkletVisitCellsWithPoints
+enum class CurvatureMetric
+{
+  SUM     = 0,
+  MEAN    = 1,
+  MAX     = 2,
+  ENTROPY = 3,
+};
+
+// Reduces the curvature of every streamline to a single value in one pass
+// over its points.  Each window (p0, p1, p2) shares the segment p0->p1 and
+// its length with the previous window, so every point and segment is only
+// loaded once.  ENTROPY is the Shannon entropy of the turning angles,
+// binned into NumAngleBins bins over [0, pi].
+template <CurvatureMetric Metric>
+class StreamlineCurvature : public vtkm::worklet::WorkletVisitCellsWithPoints
 {
 public:
   using ControlSignature = void(CellSetIn, FieldInPoint, FieldOutCell, FieldOutCell);
-  using ExecutionSignature = void(InputIndex, PointCount, _2, _3, _4);
+  using ExecutionSignature = void(PointCount, _2, _3, _4);
+
+  static constexpr vtkm::IdComponent NumAngleBins = 16;
 
   VTKM_EXEC_CONT
-  AngularEntropy(vtkm::FloatDefault threshold)
+  StreamlineCurvature(vtkm::FloatDefault threshold)
   : Threshold(threshold)
   {
   }
 
   template<typename PointVec>
   VTKM_EXEC
-  void operator()(const vtkm::IdComponent index,
-                  const vtkm::IdComponent numPoints,
+  void operator()(const vtkm::IdComponent numPoints,
                   const PointVec& streamPoints,
                   vtkm::Id& pass,
                   vtkm::FloatDefault& output) const
   {
-    (void)index;
     using Point = typename PointVec::ComponentType;
-    vtkm::VecVariable<vtkm::FloatDefault, 1000> angles;
     vtkm::FloatDefault sumCurvature = 0.;
     vtkm::FloatDefault maxCurvature = 0.;
-    for(vtkm::IdComponent i = 0; i < numPoints - 2; i++)
+    vtkm::Vec<vtkm::Id, NumAngleBins> angleBins(0);
+    vtkm::Id numAngles = 0;
+
+    if(numPoints > 2)
+    {
+      Point p1 = streamPoints[1];
+      Point a = p1 - streamPoints[0];
+      vtkm::FloatDefault lengthA = vtkm::Magnitude(a);
+      for(vtkm::IdComponent i = 2; i < numPoints; i++)
+      {
+        Point p2 = streamPoints[i];
+        Point b = p2 - p1;
+        vtkm::FloatDefault lengthB = vtkm::Magnitude(b);
+        // (p1 - p0) x (p2 - p0) == a x b
+        vtkm::FloatDefault crossLength = vtkm::Magnitude(vtkm::Cross(a, b));
+        vtkm::FloatDefault curvature = 2*crossLength / (lengthA*lengthB*vtkm::Magnitude(a + b));
+        if(vtkm::IsNan(curvature))
+          curvature = 0.0;
+        sumCurvature += curvature;
+        maxCurvature = vtkm::Max(maxCurvature, curvature);
+        if(Metric == CurvatureMetric::ENTROPY && lengthA > 0 && lengthB > 0)
+        {
+          vtkm::FloatDefault angle = vtkm::ATan2(crossLength, vtkm::Dot(a, b));
+          vtkm::IdComponent bin =
+            static_cast<vtkm::IdComponent>(angle * NumAngleBins / vtkm::Pi());
+          angleBins[vtkm::Min(vtkm::Max(bin, 0), NumAngleBins - 1)]++;
+          numAngles++;
+        }
+        p1 = p2;
+        a = b;
+        lengthA = lengthB;
+      }
+    }
+
+    switch(Metric)
     {
-      Point v1 = streamPoints[i+1] - streamPoints[i];
-      Point v2 = streamPoints[i+2] - streamPoints[i];
-      auto curvature = 2*vtkm::Magnitude(vtkm::Cross(v1,v2)) /
-                       (vtkm::Magnitude(streamPoints[i]   - streamPoints[i+1])*
-                        vtkm::Magnitude(streamPoints[i+1] - streamPoints[i+2])*
-                        vtkm::Magnitude(streamPoints[i+2] - streamPoints[i]  ));
-      if(vtkm::IsNan(curvature))
-        curvature = 0.0;
-      sumCurvature += curvature;
-      maxCurvature = vtkm::Max(static_cast<vtkm::FloatDefault>(maxCurvature),
-                               static_cast<vtkm::FloatDefault>(curvature));
+      case CurvatureMetric::SUM:
+        output = sumCurvature;
+        break;
+      case CurvatureMetric::MEAN:
+        output = (numPoints > 2) ? sumCurvature / (vtkm::FloatDefault(numPoints) - 2) : 0.;
+        break;
+      case CurvatureMetric::MAX:
+        output = maxCurvature;
+        break;
+      case CurvatureMetric::ENTROPY:
+      {
+        output = 0.;
+        for(vtkm::IdComponent bin = 0; bin < NumAngleBins; bin++)
+        {
+          if(angleBins[bin] == 0)
+            continue;
+          vtkm::FloatDefault probability =
+            vtkm::FloatDefault(angleBins[bin]) / vtkm::FloatDefault(numAngles);
+          output -= probability * vtkm::Log(probability);
+        }
+      }
+      break;
     }
-    //vtkm::FloatDefault meanCurvature = sumCurvature / (vtkm::FloatDefault(numPoints) - 2);
-    output = sumCurvature;
     if(output > this->Threshold)
       pass = 1;
     else
       pass = 0;
-    //std::cout << index << "(" << pass << ") : " << maxCurvature << std::endl;
   }
 private:
   vtkm::FloatDefault Threshold;
 };
 
+// The summed curvature FilterStreamLines has always filtered on.
+using AngularEntropy = StreamlineCurvature<CurvatureMetric::SUM>;
+
 class CountAndOffset : public vtkm::worklet::WorkletVisitCellsWithPoints
 {
 public:
@@ -93,33 +165,178 @@ public:
   }
 };
 
-} //namespace detail
+// Copies one point of the compacted connectivity.  Work is spread over
+// the output points rather than the polylines, so long streamlines do not
+// serialize on a single thread.  `cell` is the kept polyline holding the
+// point, found by a binary search of the output offsets.
+class CopyConnectivity : public vtkm::worklet::WorkletMapField
+{
+public:
+  CopyConnectivity()
+  {
+  }
 
-vtkm::cont::DataSet FilterStreamLines(const vtkm::cont::DataSet& input,
-                                      const vtkm::FloatDefault& threshold)
+  using ControlSignature = void(FieldIn, WholeArrayIn, WholeArrayIn, WholeArrayIn, FieldOut);
+  using ExecutionSignature = void(WorkIndex, _1, _2, _3, _4, _5);
+
+  template <typename OffsetsPortalType, typename InConnectivityType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id outIndex,
+                  const vtkm::Id upperBound,
+                  const OffsetsPortalType& inOffsets,
+                  const OffsetsPortalType& outOffsets,
+                  const InConnectivityType& inConnectivity,
+                  vtkm::Id& connectivity) const
+  {
+    const vtkm::Id cell = upperBound - 1;
+    connectivity = inConnectivity.Get(inOffsets.Get(cell) + outIndex - outOffsets.Get(cell));
+  }
+};
+
+// Marks every cell with (pass, kept point count) so that one extended
+// scan gives both the output cell index and the output point offset.
+class KeptCounts : public vtkm::worklet::WorkletVisitCellsWithPoints
+{
+public:
+  using ControlSignature = void(CellSetIn, FieldInCell, FieldOutCell);
+  using ExecutionSignature = void(PointCount, _2, _3);
+
+  VTKM_EXEC
+  void operator()(const vtkm::IdComponent numPoints,
+                  const vtkm::Id& pass,
+                  vtkm::Id2& counts) const
+  {
+    counts = vtkm::Id2(pass, pass ? static_cast<vtkm::Id>(numPoints) : 0);
+  }
+};
+
+// Scatters the input and output point offsets of every kept polyline to
+// its output cell index.
+class KeptOffsets : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn, FieldIn, FieldIn, WholeArrayOut, WholeArrayOut);
+  using ExecutionSignature = void(_1, _2, _3, _4, _5);
+
+  template <typename OffsetsPortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id& pass,
+                  const vtkm::Id2& outStart,
+                  const vtkm::Id& inOffset,
+                  OffsetsPortalType& inStarts,
+                  OffsetsPortalType& outOffsets) const
+  {
+    if(!pass)
+      return;
+    inStarts.Set(outStart[0], inOffset);
+    outOffsets.Set(outStart[0], outStart[1]);
+  }
+};
+
+// Writes one point of a kept polyline straight into the compacted output.
+// Like CopyConnectivity, work is spread over the output points and `cell`
+// is found by a binary search of the output offsets.  The points are
+// emitted in streamline order, so the new connectivity is just the output
+// point index.
+class EmitKeptPoint : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn, WholeArrayIn, WholeArrayIn, WholeArrayIn, FieldOut, FieldOut);
+  using ExecutionSignature = void(WorkIndex, _1, _2, _3, _4, _5, _6);
+
+  template <typename OffsetsPortalType, typename CoordsPortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id outIndex,
+                  const vtkm::Id upperBound,
+                  const OffsetsPortalType& inStarts,
+                  const OffsetsPortalType& outOffsets,
+                  const CoordsPortalType& coords,
+                  vtkm::Vec3f& outCoord,
+                  vtkm::Id& connectivity) const
+  {
+    const vtkm::Id cell = upperBound - 1;
+    auto point = coords.Get(inStarts.Get(cell) + outIndex - outOffsets.Get(cell));
+    outCoord = vtkm::Vec3f{point[0], point[1], point[2]};
+    connectivity = outIndex;
+  }
+};
+
+// Flags the connectivity entries that differ from their index.
+class NonIdentityConnectivity : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn, FieldOut);
+  using ExecutionSignature = void(WorkIndex, _1, _2);
+
+  VTKM_EXEC
+  void operator()(const vtkm::Id index, const vtkm::Id pointId, vtkm::Id& mismatch) const
+  {
+    mismatch = (pointId == index) ? 0 : 1;
+  }
+};
+
+// True when point i of the concatenated polylines is point i of the
+// coordinates : every polyline's points are contiguous, in streamline
+// order, and not shared with another polyline.
+inline bool HasStreamlineLayout(const vtkm::cont::DataSet& input)
 {
+  vtkm::cont::DynamicCellSet cells = input.GetCellSet();
+  if(!cells.IsType<vtkm::cont::CellSetExplicit<>>())
+    return false;
+  auto connectivity = cells.Cast<vtkm::cont::CellSetExplicit<>>().GetConnectivityArray(
+    vtkm::TopologyElementTagCell{}, vtkm::TopologyElementTagPoint{});
   vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandle<vtkm::Id> mismatches;
+  invoker(NonIdentityConnectivity{}, connectivity, mismatches);
+  return vtkm::cont::Algorithm::Reduce(mismatches, static_cast<vtkm::Id>(0)) == 0;
+}
 
-  vtkm::cont::ArrayHandle<vtkm::Id> filter;
+// Runs the curvature worklet to get the pass/fail mask and fills in the
+// curvature statistics for it.
+template <CurvatureMetric Metric>
+void ComputeCurvature(const vtkm::cont::DataSet& input,
+                      const vtkm::FloatDefault& threshold,
+                      vtkm::cont::ArrayHandle<vtkm::Id>& filter,
+                      statistics::CurvatureStatistics& curvatureStats)
+{
+  vtkm::cont::Invoker invoker;
   vtkm::cont::ArrayHandle<vtkm::FloatDefault> maxCurvature;
   vtkm::cont::DynamicCellSet cells = input.GetCellSet();
   vtkm::cont::CoordinateSystem coords = input.GetCoordinateSystem();
 
-  detail::AngularEntropy entropyWorklet(threshold);
-  invoker(entropyWorklet, cells, coords.GetData(), filter, maxCurvature);
-
   {
-    vtkm::cont::ArrayHandle<vtkm::FloatDefault> _maxCurvature;
-    vtkm::cont::Algorithm::Copy(maxCurvature, _maxCurvature);
-    vtkm::cont::Algorithm::Sort(_maxCurvature);
-    vtkm::Id values = _maxCurvature.GetNumberOfValues();
-    auto portal = _maxCurvature.ReadPortal();
-    std::cout << "Curvature (Min/Max) : " << portal.Get(0) << "/" << portal.Get(values-1) << std::endl;
-    std::cout << "Curvature 10% : " << portal.Get(90*(vtkm::FloatDefault(values)/100.)) << std::endl;
-    std::cout << "Curvature 20% : " << portal.Get(80*(vtkm::FloatDefault(values)/100.)) << std::endl;
-    std::cout << "Curvature 50% : " << portal.Get(50*(vtkm::FloatDefault(values)/100.)) << std::endl;
+    instrumentation::Scope scope("Curvature");
+    scope.SetCount(cells.GetNumberOfCells());
+    detail::StreamlineCurvature<Metric> curvatureWorklet(threshold);
+    invoker(curvatureWorklet, cells, coords.GetData(), filter, maxCurvature);
   }
 
+  statistics::ComputeCurvatureStatistics(maxCurvature, curvatureStats.Percentiles, curvatureStats);
+  std::ostream& log = instrumentation::Log();
+  log << "Curvature (Min/Max) : " << curvatureStats.Min << "/" << curvatureStats.Max << std::endl;
+  for(std::size_t i = 0; i < curvatureStats.Percentiles.size(); i++)
+    log << "Curvature " << (100. - curvatureStats.Percentiles[i]) << "% : "
+        << curvatureStats.Values[i] << std::endl;
+}
+
+} //namespace detail
+
+// curvatureStats.Percentiles selects which percentiles are computed; the
+// rest of the struct is filled in so callers can pick a threshold from it.
+template <detail::CurvatureMetric Metric = detail::CurvatureMetric::SUM>
+vtkm::cont::DataSet FilterStreamLines(const vtkm::cont::DataSet& input,
+                                      const vtkm::FloatDefault& threshold,
+                                      statistics::CurvatureStatistics& curvatureStats)
+{
+  vtkm::cont::Invoker invoker;
+
+  vtkm::cont::ArrayHandle<vtkm::Id> filter;
+  vtkm::cont::DynamicCellSet cells = input.GetCellSet();
+  instrumentation::Scope scope("FilterStreamLines");
+  scope.SetCount(cells.GetNumberOfCells());
+
+  detail::ComputeCurvature<Metric>(input, threshold, filter, curvatureStats);
+
   using UnstructuredType = vtkm::cont::CellSetExplicit<>;
   UnstructuredType streams = cells.Cast<UnstructuredType>();
 
@@ -138,21 +355,23 @@ vtkm::cont::DataSet FilterStreamLines(const vtkm::cont::DataSet& input,
   vtkm::cont::Algorithm::CopyIf(inOffsets, filter, offsets);
   vtkm::cont::Algorithm::CopyIf(inCounts, filter, counts);
 
-  vtkm::Id totalStreams = vtkm::cont::Algorithm::Reduce(filter, static_cast<vtkm::Id>(0));
-  vtkm::Id totalPoints  = vtkm::cont::Algorithm::Reduce(counts, static_cast<vtkm::Id>(0));
+  vtkm::Id totalStreams = offsets.GetNumberOfValues();
+
+  // Scan the kept counts to find where every kept polyline lands in the
+  // output, then gather every output point from its polyline.
+  vtkm::cont::ArrayHandle<vtkm::Id> outOffsets;
+  vtkm::cont::Algorithm::ScanExtended(counts, outOffsets);
+  vtkm::Id totalPoints = outOffsets.ReadPortal().Get(totalStreams);
 
   vtkm::cont::ArrayHandle<vtkm::Vec3f> outCoords;
   vtkm::cont::ArrayHandle<vtkm::Id> outConnectivity;
-  outConnectivity.Allocate(totalPoints);
-  auto offsetsPortal = offsets.ReadPortal();
-  auto countsPortal  = counts.ReadPortal();
-  vtkm::Id runningCount = 0;
-  for(vtkm::Id index = 0; index < totalStreams; index++)
   {
-    auto copyOffset = offsetsPortal.Get(index);
-    auto copyCount = countsPortal.Get(index);
-    vtkm::cont::Algorithm::CopySubRange(inConnectivity, copyOffset, copyCount, outConnectivity, runningCount);
-    runningCount +=copyCount;
+    instrumentation::Scope compaction("Compaction");
+    compaction.SetCount(totalPoints);
+    auto keptOffsets = vtkm::cont::make_ArrayHandleView(outOffsets, 0, totalStreams);
+    vtkm::cont::ArrayHandle<vtkm::Id> upperBounds;
+    vtkm::cont::Algorithm::UpperBounds(keptOffsets, vtkm::cont::ArrayHandleIndex(totalPoints), upperBounds);
+    invoker(detail::CopyConnectivity{}, upperBounds, offsets, outOffsets, inConnectivity, outConnectivity);
   }
 
   vtkm::cont::ArrayHandle<vtkm::UInt8> outCellTypes;
@@ -176,17 +395,94 @@ vtkm::cont::DataSet FilterStreamLines(const vtkm::cont::DataSet& input,
   }
 
   vtkm::cont::CellSetExplicit<> outStreams;
+  scope.AddBytes(totalPoints * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f) + sizeof(vtkm::Id)) +
+                 totalStreams * static_cast<vtkm::Id>(sizeof(vtkm::Id) + sizeof(vtkm::UInt8)));
+  outStreams.Fill(totalPoints, outCellTypes, outConnectivity, outOffsets);
+
+  vtkm::cont::DataSet output;
+  output.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", outCoords));
+  output.SetCellSet(outStreams);
+
+  return output;
+}
+
+template <detail::CurvatureMetric Metric = detail::CurvatureMetric::SUM>
+vtkm::cont::DataSet FilterStreamLines(const vtkm::cont::DataSet& input,
+                                      const vtkm::FloatDefault& threshold)
+{
+  statistics::CurvatureStatistics curvatureStats;
+  curvatureStats.Percentiles = {90., 80., 50.};
+  return FilterStreamLines<Metric>(input, threshold, curvatureStats);
+}
+
+// Fused version of FilterStreamLines.  After the curvature pass a single
+// extended scan over (pass, count) gives every kept streamline its output
+// cell and point offsets, and one pass per output point writes the
+// compacted coordinates and connectivity directly.  This skips the CopyIfs,
+// the connectivity copy and the Unique/Gather/SortByKey/LowerBounds
+// renumbering, but relies on the layout produced by the advection code:
+// each polyline's points are stored contiguously in streamline order and
+// no point is shared between polylines, so the connectivity is 0, 1, 2...
+// For such input the result is identical to FilterStreamLines.  The
+// layout is checked first, and other input goes through FilterStreamLines.
+template <detail::CurvatureMetric Metric = detail::CurvatureMetric::SUM>
+vtkm::cont::DataSet FilterStreamLinesFused(const vtkm::cont::DataSet& input,
+                                           const vtkm::FloatDefault& threshold,
+                                           statistics::CurvatureStatistics& curvatureStats)
+{
+  if(!detail::HasStreamlineLayout(input))
+    return FilterStreamLines<Metric>(input, threshold, curvatureStats);
+
+  vtkm::cont::Invoker invoker;
+
+  vtkm::cont::ArrayHandle<vtkm::Id> filter;
+  vtkm::cont::DynamicCellSet cells = input.GetCellSet();
+  vtkm::cont::CoordinateSystem coords = input.GetCoordinateSystem();
+  instrumentation::Scope scope("FilterStreamLines");
+  scope.SetCount(cells.GetNumberOfCells());
+
+  detail::ComputeCurvature<Metric>(input, threshold, filter, curvatureStats);
+
+  vtkm::Id numCells = cells.GetNumberOfCells();
+  vtkm::cont::ArrayHandle<vtkm::Id2> keptCounts;
+  invoker(detail::KeptCounts{}, cells, filter, keptCounts);
+  vtkm::cont::ArrayHandle<vtkm::Id2> outStarts;
+  vtkm::cont::Algorithm::ScanExtended(keptCounts, outStarts);
+  vtkm::Id2 totals = outStarts.ReadPortal().Get(numCells);
+  vtkm::Id totalStreams = totals[0];
+  vtkm::Id totalPoints = totals[1];
+
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> outCoords;
+  vtkm::cont::ArrayHandle<vtkm::Id> outConnectivity;
+  vtkm::cont::ArrayHandle<vtkm::Id> outOffsets;
   {
-    vtkm::cont::Algorithm::ScanExclusive(counts, offsets);
-    auto numVals = offsets.GetNumberOfValues();
-    vtkm::cont::ArrayHandle<vtkm::Id> _temp;
-    _temp.Allocate(numVals + 1);
-    vtkm::cont::Algorithm::CopySubRange(offsets, 0, numVals, _temp, 0);
-    auto _tempPortal = _temp.WritePortal();
-    _tempPortal.Set(numVals, runningCount);
-    vtkm::cont::Algorithm::Copy(_temp, offsets);
+    instrumentation::Scope compaction("Compaction");
+    compaction.SetCount(totalPoints);
+    auto inOffsets = cells.Cast<vtkm::cont::CellSetExplicit<>>().GetOffsetsArray(
+      vtkm::TopologyElementTagCell{}, vtkm::TopologyElementTagPoint{});
+    vtkm::cont::ArrayHandle<vtkm::Id> inStarts;
+    inStarts.Allocate(totalStreams);
+    outOffsets.Allocate(totalStreams + 1);
+    invoker(detail::KeptOffsets{}, filter, vtkm::cont::make_ArrayHandleView(outStarts, 0, numCells),
+            vtkm::cont::make_ArrayHandleView(inOffsets, 0, numCells), inStarts, outOffsets);
+    outOffsets.WritePortal().Set(totalStreams, totalPoints);
+
+    auto keptOffsets = vtkm::cont::make_ArrayHandleView(outOffsets, 0, totalStreams);
+    vtkm::cont::ArrayHandle<vtkm::Id> upperBounds;
+    vtkm::cont::Algorithm::UpperBounds(keptOffsets, vtkm::cont::ArrayHandleIndex(totalPoints), upperBounds);
+    invoker(detail::EmitKeptPoint{}, upperBounds, inStarts, outOffsets, coords.GetData(),
+            outCoords, outConnectivity);
   }
-  outStreams.Fill(totalPoints, outCellTypes, outConnectivity, offsets);
+
+  vtkm::cont::ArrayHandle<vtkm::UInt8> outCellTypes;
+  auto polyLineShape =
+    vtkm::cont::make_ArrayHandleConstant<vtkm::UInt8>(vtkm::CELL_SHAPE_POLY_LINE, totalStreams);
+  vtkm::cont::ArrayCopy(polyLineShape, outCellTypes);
+
+  vtkm::cont::CellSetExplicit<> outStreams;
+  scope.AddBytes(totalPoints * static_cast<vtkm::Id>(sizeof(vtkm::Vec3f) + sizeof(vtkm::Id)) +
+                 totalStreams * static_cast<vtkm::Id>(sizeof(vtkm::Id) + sizeof(vtkm::UInt8)));
+  outStreams.Fill(totalPoints, outCellTypes, outConnectivity, outOffsets);
 
   vtkm::cont::DataSet output;
   output.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", outCoords));
@@ -194,3 +490,13 @@ vtkm::cont::DataSet FilterStreamLines(const vtkm::cont::DataSet& input,
 
   return output;
 }
+
+// Instantiated in FilterStreamlines.cxx.
+extern template vtkm::cont::DataSet FilterStreamLines<detail::CurvatureMetric::SUM>(
+  const vtkm::cont::DataSet&, const vtkm::FloatDefault&, statistics::CurvatureStatistics&);
+extern template vtkm::cont::DataSet FilterStreamLines<detail::CurvatureMetric::SUM>(
+  const vtkm::cont::DataSet&, const vtkm::FloatDefault&);
+extern template vtkm::cont::DataSet FilterStreamLinesFused<detail::CurvatureMetric::SUM>(
+  const vtkm::cont::DataSet&, const vtkm::FloatDefault&, statistics::CurvatureStatistics&);
+
+#endif
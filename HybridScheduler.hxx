@@ -0,0 +1,286 @@
+#ifndef scheduling_hybrid_scheduler_hxx
+#define scheduling_hybrid_scheduler_hxx
+
+#include <algorithm>
+#include <exception>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Particle.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/DeviceAdapterTag.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/cont/RuntimeDeviceTracker.h>
+#include <vtkm/cont/Timer.h>
+
+#include "ChunkedHistory.hxx"
+#include "DomainDecomposition.hxx"
+#include "FieldEvaluators.hxx"
+
+namespace scheduling
+{
+
+namespace detail
+{
+
+struct IsBlock
+{
+  VTKM_EXEC_CONT IsBlock(vtkm::Id block = 0)
+  : Block(block)
+  {}
+
+  VTKM_EXEC_CONT bool operator()(vtkm::Id owner) const { return owner == this->Block; }
+
+  vtkm::Id Block;
+};
+
+// Splits `particles` into `numParts` consecutive parts of nearly equal size.
+inline std::vector<vtkm::cont::ArrayHandle<vtkm::ChargedParticle>> Split(
+  const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& particles,
+  std::size_t numParts)
+{
+  std::vector<vtkm::cont::ArrayHandle<vtkm::ChargedParticle>> parts(numParts);
+  vtkm::Id count = particles.GetNumberOfValues();
+  for(std::size_t part = 0; part < numParts; part++)
+  {
+    vtkm::Id begin = count * static_cast<vtkm::Id>(part) / static_cast<vtkm::Id>(numParts);
+    vtkm::Id end = count * static_cast<vtkm::Id>(part + 1) / static_cast<vtkm::Id>(numParts);
+    vtkm::cont::Algorithm::CopySubRange(particles, begin, end - begin, parts[part]);
+  }
+  return parts;
+}
+
+} // namespace detail
+
+/*
+ * Assigns the blocks to workers from the number of particles seeded in
+ * each.  Blocks go, heaviest first, to the least loaded workers.  With
+ * `replicateHot`, a block holding more than a worker's fair share of the
+ * particles is given to as many workers as it has fair shares, each of
+ * which advects part of its particles.  Returns the workers of every block.
+ */
+inline std::vector<std::vector<vtkm::Id>> PlanBlocks(const std::vector<vtkm::Id>& counts,
+                                                     vtkm::Id numWorkers,
+                                                     bool replicateHot)
+{
+  vtkm::Id total = std::accumulate(counts.begin(), counts.end(), vtkm::Id(0));
+  vtkm::Id fairShare = vtkm::Max((total + numWorkers - 1) / numWorkers, vtkm::Id(1));
+  std::vector<std::size_t> order(counts.size());
+  std::iota(order.begin(), order.end(), std::size_t(0));
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) { return counts[a] > counts[b]; });
+
+  std::vector<std::vector<vtkm::Id>> plan(counts.size());
+  std::vector<vtkm::Id> loads(static_cast<std::size_t>(numWorkers), 0);
+  std::vector<vtkm::Id> workers(static_cast<std::size_t>(numWorkers));
+  for(std::size_t block : order)
+  {
+    vtkm::Id replicas = 1;
+    if(replicateHot)
+      replicas = vtkm::Min(vtkm::Max((counts[block] + fairShare - 1) / fairShare, vtkm::Id(1)), numWorkers);
+    std::iota(workers.begin(), workers.end(), vtkm::Id(0));
+    std::stable_sort(workers.begin(), workers.end(),
+                     [&](vtkm::Id a, vtkm::Id b) { return loads[static_cast<std::size_t>(a)] < loads[static_cast<std::size_t>(b)]; });
+    for(vtkm::Id replica = 0; replica < replicas; replica++)
+    {
+      vtkm::Id worker = workers[static_cast<std::size_t>(replica)];
+      plan[block].push_back(worker);
+      loads[static_cast<std::size_t>(worker)] += counts[block] / replicas;
+    }
+  }
+  return plan;
+}
+
+/*
+ * In-process scheduler over z blocks of the field grid, one thread per
+ * worker.  Every worker advects the particles of the blocks it was given,
+ * stopping them on the side of the block, and particles that crossed into
+ * another block are handed to that block's workers for the next round.
+ *
+ * Blocks are planned by PlanBlocks from the particle density measured on
+ * the seeds.  With plain block ownership every block has one worker and a
+ * clustered beam loads the worker of its block only.  The hybrid plan
+ * replicates the hot blocks, splitting their particles by seed between
+ * several workers, while cold blocks stay with a single worker.  Workers
+ * share the field arrays, so replicating a block copies nothing.
+ */
+template <typename EvaluatorType>
+class HybridScheduler
+{
+public:
+  HybridScheduler(const EvaluatorType& evaluator,
+                  const vtkm::Bounds& bounds,
+                  const std::vector<distributed::Slab>& blocks,
+                  vtkm::Id numWorkers,
+                  vtkm::FloatDefault stepLength,
+                  vtkm::Id maxSteps)
+  : Evaluator(evaluator)
+  , Bounds(bounds)
+  , BlockRanges(distributed::GetSlabRanges(blocks))
+  , NumberOfWorkers(numWorkers)
+  , StepLength(stepLength)
+  , MaxSteps(maxSteps)
+  , NumberOfRounds(0)
+  , NumberOfReplicas(0)
+  , NumberOfSteps(0)
+  {
+    for(const auto& block : blocks)
+    {
+      vtkm::Bounds blockBounds = bounds;
+      blockBounds.Z = block.Z;
+      this->BlockBounds.push_back(blockBounds);
+    }
+  }
+
+  // Advects copies of `seeds`, with hot blocks replicated when `replicateHot`.
+  void Advect(const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& seeds, bool replicateHot)
+  {
+    using SeedsType = vtkm::cont::ArrayHandle<vtkm::ChargedParticle>;
+    std::size_t numBlocks = this->BlockBounds.size();
+    std::size_t numWorkers = static_cast<std::size_t>(this->NumberOfWorkers);
+    vtkm::cont::Invoker invoker;
+
+    vtkm::cont::ArrayHandle<vtkm::Id> owners;
+    invoker(distributed::detail::Owner{}, seeds, this->BlockRanges, owners);
+    std::vector<vtkm::Id> counts(numBlocks, 0);
+    auto ownerPortal = owners.ReadPortal();
+    for(vtkm::Id i = 0; i < ownerPortal.GetNumberOfValues(); i++)
+      counts[static_cast<std::size_t>(ownerPortal.Get(i))]++;
+    std::vector<std::vector<vtkm::Id>> plan = PlanBlocks(counts, this->NumberOfWorkers, replicateHot);
+    this->NumberOfReplicas = 0;
+    for(const auto& workers : plan)
+      this->NumberOfReplicas += static_cast<vtkm::Id>(workers.size());
+
+    // Particles of every block, before they are split among its workers.
+    std::vector<SeedsType> arrivals(numBlocks);
+    for(std::size_t block = 0; block < numBlocks; block++)
+      vtkm::cont::Algorithm::CopyIf(seeds, owners, arrivals[block], detail::IsBlock(static_cast<vtkm::Id>(block)));
+
+    this->WorkerTimes.assign(numWorkers, 0);
+    this->NumberOfRounds = 0;
+    this->NumberOfSteps = 0;
+    bool inFlight = true;
+    while(inFlight)
+    {
+      std::vector<std::vector<std::pair<std::size_t, SeedsType>>> work(numWorkers);
+      for(std::size_t block = 0; block < numBlocks; block++)
+      {
+        if(arrivals[block].GetNumberOfValues() == 0)
+          continue;
+        auto parts = detail::Split(arrivals[block], plan[block].size());
+        for(std::size_t part = 0; part < parts.size(); part++)
+          work[static_cast<std::size_t>(plan[block][part])].emplace_back(block, parts[part]);
+      }
+
+      // outbox[worker][block] : particles leaving for `block`.
+      std::vector<std::vector<std::vector<vtkm::ChargedParticle>>> outbox(
+        numWorkers, std::vector<std::vector<vtkm::ChargedParticle>>(numBlocks));
+      std::vector<vtkm::Id> steps(numWorkers, 0);
+      std::vector<std::exception_ptr> errors(numWorkers);
+      std::vector<std::thread> threads;
+      for(std::size_t worker = 0; worker < numWorkers; worker++)
+      {
+        threads.emplace_back([&, worker]() {
+          try
+          {
+            this->RunWorker(work[worker], outbox[worker], steps[worker], this->WorkerTimes[worker]);
+          }
+          catch(...)
+          {
+            errors[worker] = std::current_exception();
+          }
+        });
+      }
+      for(auto& thread : threads)
+        thread.join();
+      for(const auto& error : errors)
+      {
+        if(error)
+          std::rethrow_exception(error);
+      }
+
+      inFlight = false;
+      for(std::size_t block = 0; block < numBlocks; block++)
+      {
+        std::vector<vtkm::ChargedParticle> incoming;
+        for(std::size_t worker = 0; worker < numWorkers; worker++)
+          incoming.insert(incoming.end(), outbox[worker][block].begin(), outbox[worker][block].end());
+        arrivals[block] = vtkm::cont::make_ArrayHandle(incoming, vtkm::CopyFlag::On);
+        if(!incoming.empty())
+        {
+          invoker(distributed::detail::Arrive{}, arrivals[block]);
+          inFlight = true;
+        }
+      }
+      this->NumberOfSteps += std::accumulate(steps.begin(), steps.end(), vtkm::Id(0));
+      this->NumberOfRounds++;
+    }
+  }
+
+  // Time every worker spent advecting, in seconds.
+  const std::vector<vtkm::Float64>& GetWorkerTimes() const { return this->WorkerTimes; }
+  vtkm::Id GetNumberOfRounds() const { return this->NumberOfRounds; }
+  // Blocks plus their extra replicas in the last plan.
+  vtkm::Id GetNumberOfReplicas() const { return this->NumberOfReplicas; }
+  vtkm::Id GetNumberOfSteps() const { return this->NumberOfSteps; }
+
+private:
+  // Runs on the thread of a worker, with the serial device so that the
+  // workers are the only source of parallelism.
+  void RunWorker(const std::vector<std::pair<std::size_t, vtkm::cont::ArrayHandle<vtkm::ChargedParticle>>>& work,
+                 std::vector<std::vector<vtkm::ChargedParticle>>& outbox,
+                 vtkm::Id& steps,
+                 vtkm::Float64& time) const
+  {
+    using BlockEvaluatorType = integration::BlockEvaluator<EvaluatorType>;
+    using ParticleType = history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>;
+    vtkm::cont::ScopedRuntimeDeviceTracker tracker(vtkm::cont::DeviceAdapterTagSerial{});
+    vtkm::cont::Invoker invoker;
+    vtkm::cont::Timer timer{ vtkm::cont::DeviceAdapterTagSerial{} };
+    vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+    for(const auto& item : work)
+    {
+      vtkm::cont::ArrayHandle<vtkm::ChargedParticle> particles = item.second;
+      BlockEvaluatorType evaluator(this->Evaluator, this->BlockBounds[item.first]);
+      integration::RK4Stepper<BlockEvaluatorType> stepper(evaluator, this->StepLength);
+      ParticleType history(particles, this->MaxSteps);
+      timer.Start();
+      history.Advect(stepper);
+      timer.Stop();
+      time += timer.GetElapsedTime();
+      steps += history::CountSteps(history, numPoints);
+
+      vtkm::cont::ArrayHandle<vtkm::Id> destinations;
+      invoker(distributed::detail::Destination(this->Bounds, static_cast<vtkm::Id>(item.first)),
+              particles, this->BlockRanges, destinations);
+      auto particlePortal = particles.ReadPortal();
+      auto destinationPortal = destinations.ReadPortal();
+      for(vtkm::Id i = 0; i < particlePortal.GetNumberOfValues(); i++)
+      {
+        vtkm::Id destination = destinationPortal.Get(i);
+        if(destination >= 0)
+          outbox[static_cast<std::size_t>(destination)].push_back(particlePortal.Get(i));
+      }
+    }
+  }
+
+  EvaluatorType Evaluator;
+  vtkm::Bounds Bounds;
+  std::vector<vtkm::Bounds> BlockBounds;
+  vtkm::cont::ArrayHandle<vtkm::Range> BlockRanges;
+  vtkm::Id NumberOfWorkers;
+  vtkm::FloatDefault StepLength;
+  vtkm::Id MaxSteps;
+  std::vector<vtkm::Float64> WorkerTimes;
+  vtkm::Id NumberOfRounds;
+  vtkm::Id NumberOfReplicas;
+  vtkm::Id NumberOfSteps;
+};
+
+} // namespace scheduling
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef instrumentation_h
+#define instrumentation_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+
+#include "Device.h"
+
+/*
+ * Per-stage instrumentation.  A Scope placed at the top of a stage records
+ * its wall time, the number of elements it processed, the bytes it
+ * allocated and the device it ran on.  Recording is off unless a Session
+ * is open, and a disabled Scope only tests a flag, so scopes can stay in
+ * the hot paths.  Enabled scopes synchronize the device when they close so
+ * that asynchronous launches are charged to the stage that made them.
+ */
+namespace instrumentation
+{
+
+struct Event
+{
+  std::string Name;
+  // Microseconds since the recorder was created.
+  vtkm::Float64 Start;
+  vtkm::Float64 Duration;
+  int Thread;
+  vtkm::Id Count;
+  vtkm::Id Bytes;
+  std::string Device;
+};
+
+// Device VTK-m schedules on from this thread.
+inline std::string GetDeviceName()
+{
+  vtkm::cont::DeviceAdapterId id = device::GetDevice();
+  return id == vtkm::cont::DeviceAdapterTagUndefined{} ? "none" : id.GetName();
+}
+
+class Recorder
+{
+public:
+  static Recorder& Get()
+  {
+    static Recorder recorder;
+    return recorder;
+  }
+
+  void SetEnabled(bool enabled) { this->Enabled.store(enabled, std::memory_order_relaxed); }
+  bool IsEnabled() const { return this->Enabled.load(std::memory_order_relaxed); }
+
+  vtkm::Float64 Now() const
+  {
+    std::chrono::duration<vtkm::Float64, std::micro> elapsed = std::chrono::steady_clock::now() - this->Origin;
+    return elapsed.count();
+  }
+
+  void Record(Event event)
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    auto inserted = this->Threads.emplace(std::this_thread::get_id(), static_cast<int>(this->Threads.size()));
+    event.Thread = inserted.first->second;
+    this->Events.push_back(std::move(event));
+  }
+
+  // Trace Event Format, for chrome://tracing or Perfetto.
+  void WriteChromeTrace(const std::string& fileName) const
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::ofstream trace(fileName);
+    trace << "{\"traceEvents\": [" << std::endl;
+    for(std::size_t i = 0; i < this->Events.size(); i++)
+    {
+      const Event& event = this->Events[i];
+      trace << "  {\"name\": \"" << event.Name << "\", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 0"
+            << ", \"tid\": " << event.Thread << std::fixed << std::setprecision(3) << ", \"ts\": " << event.Start
+            << ", \"dur\": " << event.Duration << ", \"args\": {\"count\": " << event.Count
+            << ", \"bytes\": " << event.Bytes << ", \"device\": \"" << event.Device << "\"}}"
+            << (i + 1 < this->Events.size() ? "," : "") << std::endl;
+    }
+    trace << "]}" << std::endl;
+  }
+
+  // Calls, total and mean time, elements and bytes of every stage, the
+  // longest stages first.
+  void PrintSummary(std::ostream& out) const
+  {
+    struct Stage
+    {
+      std::string Name;
+      vtkm::Id Calls = 0;
+      vtkm::Float64 Total = 0;
+      vtkm::Float64 Max = 0;
+      vtkm::Id Count = 0;
+      vtkm::Id Bytes = 0;
+      std::string Device;
+    };
+    std::vector<Stage> stages;
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      std::map<std::string, std::size_t> index;
+      for(const Event& event : this->Events)
+      {
+        auto inserted = index.emplace(event.Name, stages.size());
+        if(inserted.second)
+          stages.push_back(Stage{ event.Name });
+        Stage& stage = stages[inserted.first->second];
+        stage.Calls++;
+        stage.Total += event.Duration;
+        stage.Max = std::max(stage.Max, event.Duration);
+        stage.Count += event.Count;
+        stage.Bytes += event.Bytes;
+        stage.Device = event.Device;
+      }
+    }
+    std::stable_sort(stages.begin(), stages.end(),
+                     [](const Stage& a, const Stage& b) { return a.Total > b.Total; });
+
+    out << std::left << std::setw(24) << "Stage" << std::right << std::setw(8) << "Calls" << std::setw(14)
+        << "Total (s)" << std::setw(14) << "Mean (s)" << std::setw(14) << "Max (s)" << std::setw(14)
+        << "Elements" << std::setw(14) << "Bytes" << "  Device" << std::endl;
+    for(const Stage& stage : stages)
+    {
+      out << std::left << std::setw(24) << stage.Name << std::right << std::setw(8) << stage.Calls
+          << std::scientific << std::setprecision(3) << std::setw(14) << stage.Total * 1e-6 << std::setw(14)
+          << stage.Total * 1e-6 / stage.Calls << std::setw(14) << stage.Max * 1e-6 << std::defaultfloat
+          << std::setw(14) << stage.Count << std::setw(14) << stage.Bytes << "  " << stage.Device << std::endl;
+    }
+  }
+
+private:
+  Recorder()
+  : Enabled(false)
+  , Origin(std::chrono::steady_clock::now())
+  {}
+
+  std::atomic<bool> Enabled;
+  std::chrono::steady_clock::time_point Origin;
+  mutable std::mutex Mutex;
+  std::map<std::thread::id, int> Threads;
+  std::vector<Event> Events;
+};
+
+// Records the stage it is alive for.  `name` has to be a literal, or
+// outlive the scope.
+class Scope
+{
+public:
+  explicit Scope(const char* name)
+  : Name(name)
+  , Active(Recorder::Get().IsEnabled())
+  , Start(0)
+  , Count(0)
+  , Bytes(0)
+  {
+    if(this->Active)
+      this->Start = Recorder::Get().Now();
+  }
+
+  ~Scope()
+  {
+    if(!this->Active)
+      return;
+    vtkm::cont::Algorithm::Synchronize();
+    Recorder& recorder = Recorder::Get();
+    recorder.Record(
+      { this->Name, this->Start, recorder.Now() - this->Start, 0, this->Count, this->Bytes, GetDeviceName() });
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+  // Elements processed by the stage.
+  void SetCount(vtkm::Id count) { this->Count = count; }
+  // Bytes allocated by the stage.
+  void AddBytes(vtkm::Id bytes) { this->Bytes += bytes; }
+
+private:
+  const char* Name;
+  bool Active;
+  vtkm::Float64 Start;
+  vtkm::Id Count;
+  vtkm::Id Bytes;
+};
+
+// Enables recording while it is open, when `traceFile` is not empty.  On
+// close the trace is written to `traceFile` and the summary printed.
+class Session
+{
+public:
+  explicit Session(const std::string& traceFile)
+  : TraceFile(traceFile)
+  {
+    if(!this->TraceFile.empty())
+      Recorder::Get().SetEnabled(true);
+  }
+
+  ~Session()
+  {
+    if(this->TraceFile.empty())
+      return;
+    Recorder& recorder = Recorder::Get();
+    recorder.SetEnabled(false);
+    recorder.WriteChromeTrace(this->TraceFile);
+    recorder.PrintSummary(std::cout);
+    std::cout << "Trace : " << this->TraceFile << std::endl;
+  }
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+private:
+  std::string TraceFile;
+};
+
+namespace detail
+{
+
+inline std::atomic<bool>& Verbose()
+{
+  static std::atomic<bool> verbose(false);
+  return verbose;
+}
+
+} // namespace detail
+
+// Diagnostics of the library code, such as the evaluator picked or the
+// curvature statistics, are only printed with `verbose=true`.
+inline void SetVerbose(bool verbose) { detail::Verbose().store(verbose, std::memory_order_relaxed); }
+inline bool IsVerbose() { return detail::Verbose().load(std::memory_order_relaxed); }
+
+// std::cout when verbose, a stream discarding its output otherwise.
+inline std::ostream& Log()
+{
+  static std::ostream discard(nullptr);
+  return IsVerbose() ? std::cout : discard;
+}
+
+/*
+ * Hardware cache misses of the whole process between Start and Stop,
+ * counted by the kernel through perf_event_open on every thread alive at
+ * Start and the threads they create later.  The device thread pools have
+ * to exist by then, which they do once anything has run on the device.
+ * Only user space misses are counted.  IsAvailable is false without Linux
+ * perf events, or when perf_event_paranoid forbids them.
+ */
+class CacheMissCounter
+{
+public:
+  CacheMissCounter() = default;
+  ~CacheMissCounter() { this->Close(); }
+
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  void Start()
+  {
+    this->Close();
+#ifdef __linux__
+    DIR* tasks = opendir("/proc/self/task");
+    if(tasks == nullptr)
+      return;
+    while(dirent* entry = readdir(tasks))
+    {
+      if(entry->d_name[0] == '.')
+        continue;
+      perf_event_attr attr = {};
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      pid_t tid = static_cast<pid_t>(std::stoi(entry->d_name));
+      long fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+      if(fd < 0)
+      {
+        closedir(tasks);
+        this->Close();
+        return;
+      }
+      this->Descriptors.push_back(static_cast<int>(fd));
+    }
+    closedir(tasks);
+    for(int fd : this->Descriptors)
+    {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  // Misses since Start, -1 when they could not be counted.
+  vtkm::Int64 Stop()
+  {
+    if(this->Descriptors.empty())
+      return -1;
+    vtkm::Int64 misses = 0;
+#ifdef __linux__
+    for(int fd : this->Descriptors)
+    {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      vtkm::UInt64 count = 0;
+      if(read(fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count)))
+        misses = -1;
+      else if(misses >= 0)
+        misses += static_cast<vtkm::Int64>(count);
+    }
+#endif
+    this->Close();
+    return misses;
+  }
+
+private:
+  void Close()
+  {
+#ifdef __linux__
+    for(int fd : this->Descriptors)
+      close(fd);
+#endif
+    this->Descriptors.clear();
+  }
+
+  std::vector<int> Descriptors;
+};
+
+} // namespace instrumentation
+
+#endif
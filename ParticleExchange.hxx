@@ -0,0 +1,115 @@
+#ifndef distributed_particle_exchange_hxx
+#define distributed_particle_exchange_hxx
+
+#include <vector>
+
+#include <mpi.h>
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleBasic.h>
+#include <vtkm/cont/Token.h>
+
+namespace distributed
+{
+
+namespace detail
+{
+
+struct Leaves
+{
+  VTKM_EXEC_CONT bool operator()(vtkm::Id destination) const { return destination >= 0; }
+};
+
+struct Stays
+{
+  VTKM_EXEC_CONT bool operator()(vtkm::Id destination) const { return destination < 0; }
+};
+
+} // namespace detail
+
+/*
+ * Moves particles between ranks in a single MPI_Alltoallv.  Particles are
+ * trivially copyable, so they travel as they are in memory, described by
+ * a contiguous MPI type of sizeof(ParticleType) bytes.
+ */
+template <typename ParticleType>
+class ParticleExchange
+{
+public:
+  ParticleExchange(MPI_Comm comm)
+  : Comm(comm)
+  , NumberOfSent(0)
+  , NumberOfReceived(0)
+  {
+    MPI_Type_contiguous(static_cast<int>(sizeof(ParticleType)), MPI_BYTE, &this->Type);
+    MPI_Type_commit(&this->Type);
+  }
+
+  ~ParticleExchange() { MPI_Type_free(&this->Type); }
+
+  ParticleExchange(const ParticleExchange&) = delete;
+  ParticleExchange& operator=(const ParticleExchange&) = delete;
+
+  // Sends particle i to rank destinations[i], keeping those whose
+  // destination is negative in `remaining`.  Collective over the
+  // communicator.
+  void Exchange(const vtkm::cont::ArrayHandle<ParticleType>& particles,
+                const vtkm::cont::ArrayHandle<vtkm::Id>& destinations,
+                vtkm::cont::ArrayHandle<ParticleType>& remaining,
+                vtkm::cont::ArrayHandle<ParticleType>& received)
+  {
+    int size;
+    MPI_Comm_size(this->Comm, &size);
+
+    vtkm::cont::ArrayHandleBasic<ParticleType> outgoing;
+    vtkm::cont::ArrayHandle<vtkm::Id> keys;
+    vtkm::cont::Algorithm::CopyIf(particles, destinations, outgoing, detail::Leaves{});
+    vtkm::cont::Algorithm::CopyIf(destinations, destinations, keys, detail::Leaves{});
+    vtkm::cont::Algorithm::CopyIf(particles, destinations, remaining, detail::Stays{});
+    vtkm::cont::Algorithm::SortByKey(keys, outgoing);
+
+    std::vector<int> sendCounts(static_cast<std::size_t>(size), 0);
+    auto keyPortal = keys.ReadPortal();
+    for(vtkm::Id i = 0; i < keyPortal.GetNumberOfValues(); i++)
+      sendCounts[static_cast<std::size_t>(keyPortal.Get(i))]++;
+    std::vector<int> recvCounts(static_cast<std::size_t>(size));
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, this->Comm);
+
+    std::vector<int> sendOffsets(static_cast<std::size_t>(size), 0);
+    std::vector<int> recvOffsets(static_cast<std::size_t>(size), 0);
+    for(std::size_t rank = 1; rank < sendCounts.size(); rank++)
+    {
+      sendOffsets[rank] = sendOffsets[rank - 1] + sendCounts[rank - 1];
+      recvOffsets[rank] = recvOffsets[rank - 1] + recvCounts[rank - 1];
+    }
+    vtkm::Id numReceived = static_cast<vtkm::Id>(recvOffsets.back()) + recvCounts.back();
+
+    vtkm::cont::ArrayHandleBasic<ParticleType> incoming;
+    incoming.Allocate(numReceived);
+    {
+      vtkm::cont::Token token;
+      MPI_Alltoallv(outgoing.GetReadPointer(token), sendCounts.data(), sendOffsets.data(), this->Type,
+                    incoming.GetWritePointer(token), recvCounts.data(), recvOffsets.data(), this->Type,
+                    this->Comm);
+    }
+    received = incoming;
+    this->NumberOfSent += outgoing.GetNumberOfValues();
+    this->NumberOfReceived += numReceived;
+  }
+
+  // Particles sent and received by this rank over all exchanges.
+  vtkm::Id GetNumberOfSent() const { return this->NumberOfSent; }
+  vtkm::Id GetNumberOfReceived() const { return this->NumberOfReceived; }
+
+private:
+  MPI_Comm Comm;
+  MPI_Datatype Type;
+  vtkm::Id NumberOfSent;
+  vtkm::Id NumberOfReceived;
+};
+
+} // namespace distributed
+
+#endif
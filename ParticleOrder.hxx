@@ -0,0 +1,236 @@
+#ifndef locality_particle_order_hxx
+#define locality_particle_order_hxx
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Types.h>
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/ArrayHandleTransform.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/cont/Timer.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "ChunkedHistory.hxx"
+#include "Instrumentation.h"
+#include "SpatialIndex.hxx"
+
+namespace locality
+{
+
+namespace detail
+{
+
+struct ParticlePosition
+{
+  template <typename ParticleType>
+  VTKM_EXEC_CONT vtkm::Vec3f operator()(const ParticleType& p) const
+  {
+    return p.Pos;
+  }
+};
+
+// Particles that stopped moving get the largest key and end up behind
+// the others.
+class StoppedLast : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn particle, FieldInOut key);
+  using ExecutionSignature = void(_1, _2);
+
+  template <typename ParticleType>
+  VTKM_EXEC
+  void operator()(const ParticleType& p, vtkm::UInt64& key) const
+  {
+    if(!history::detail::CanMove(p))
+      key = ~vtkm::UInt64(0);
+  }
+};
+
+class CanMove : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn particle, FieldOut canMove);
+  using ExecutionSignature = void(_1, _2);
+
+  template <typename ParticleType>
+  VTKM_EXEC
+  void operator()(const ParticleType& p, vtkm::UInt8& canMove) const
+  {
+    canMove = history::detail::CanMove(p) ? 1 : 0;
+  }
+};
+
+struct IsZero
+{
+  VTKM_EXEC_CONT bool operator()(vtkm::UInt8 value) const { return value == 0; }
+};
+
+class NeighbourDistance : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn index, WholeArrayIn particles, FieldOut distance);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename ParticlePortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id index,
+                  const ParticlePortalType& particles,
+                  vtkm::FloatDefault& distance) const
+  {
+    distance = vtkm::Magnitude(particles.Get(index + 1).Pos - particles.Get(index).Pos);
+  }
+};
+
+} // namespace detail
+
+// Mean distance between particles next to each other in the array, a
+// cheap measure of how coherent the field fetches of an advection are.
+template <typename ParticleType>
+vtkm::FloatDefault MeanNeighbourDistance(const vtkm::cont::ArrayHandle<ParticleType>& particles)
+{
+  vtkm::Id numPairs = particles.GetNumberOfValues() - 1;
+  if(numPairs < 1)
+    return 0;
+  vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> distances;
+  invoker(detail::NeighbourDistance{}, vtkm::cont::ArrayHandleIndex(numPairs), particles, distances);
+  return vtkm::cont::Algorithm::Reduce(distances, vtkm::FloatDefault(0)) / numPairs;
+}
+
+/*
+ * Keeps the particles of a history::ChunkedStateRecordingParticles sorted
+ * along a Morton curve over the field bounds.  The advection worklet runs
+ * neighbouring particles together, so after sorting they fetch the same
+ * or nearby cells instead of jumping across the grid.  Particles that
+ * stopped moving are kept behind the others, by Sort and by the cheaper
+ * Compact.  The input index of every particle is tracked, and Restore
+ * puts the particles and their histories back in input order so that
+ * outputs are unchanged by the reordering.
+ */
+class ParticleOrder
+{
+public:
+  VTKM_CONT
+  ParticleOrder(const vtkm::Bounds& bounds)
+  : Bounds(bounds)
+  , NumberOfSorts(0)
+  , SortTime(0)
+  , InputDistance(0)
+  , SortedDistance(0)
+  {}
+
+  // Sorts the particles that can move by the Morton key of their position,
+  // followed by those that stopped.
+  template <typename HistoryType>
+  VTKM_CONT
+  void Sort(HistoryType& history)
+  {
+    if(this->NumberOfSorts == 0)
+      this->InputDistance = MeanNeighbourDistance(history.GetParticles());
+    instrumentation::Scope scope("Reorder");
+    scope.SetCount(history.GetParticles().GetNumberOfValues());
+    vtkm::cont::Timer timer;
+    timer.Start();
+    vtkm::cont::Invoker invoker;
+    vtkm::cont::ArrayHandle<vtkm::UInt64> keys;
+    auto positions = vtkm::cont::make_ArrayHandleTransform(history.GetParticles(), detail::ParticlePosition{});
+    invoker(seeding::detail::MortonKey(this->Bounds), positions, keys);
+    invoker(detail::StoppedLast{}, history.GetParticles(), keys);
+    vtkm::cont::ArrayHandle<vtkm::Id> order;
+    vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(keys.GetNumberOfValues()), order);
+    vtkm::cont::Algorithm::SortByKey(keys, order);
+    this->Apply(history, order);
+    timer.Stop();
+    this->NumberOfSorts++;
+    this->SortTime += timer.GetElapsedTime();
+    if(this->NumberOfSorts == 1)
+      this->SortedDistance = MeanNeighbourDistance(history.GetParticles());
+  }
+
+  // Moves the particles that stopped behind those that can still move,
+  // keeping the order within both groups.  Returns the number of particles
+  // that can move.
+  template <typename HistoryType>
+  VTKM_CONT
+  vtkm::Id Compact(HistoryType& history)
+  {
+    vtkm::cont::Invoker invoker;
+    vtkm::Id numParticles = history.GetParticles().GetNumberOfValues();
+    instrumentation::Scope scope("Compaction");
+    scope.SetCount(numParticles);
+    vtkm::cont::ArrayHandle<vtkm::UInt8> canMove;
+    invoker(detail::CanMove{}, history.GetParticles(), canMove);
+    vtkm::cont::ArrayHandle<vtkm::Id> moving;
+    vtkm::cont::Algorithm::CopyIf(vtkm::cont::ArrayHandleIndex(numParticles), canMove, moving);
+    vtkm::Id numMoving = moving.GetNumberOfValues();
+    // The indices are ascending, so they are 0 .. numMoving - 1 when all
+    // moving particles are already at the front.
+    if(numMoving == 0 || moving.ReadPortal().Get(numMoving - 1) == numMoving - 1)
+      return numMoving;
+
+    vtkm::cont::ArrayHandle<vtkm::Id> stopped;
+    vtkm::cont::Algorithm::CopyIf(vtkm::cont::ArrayHandleIndex(numParticles), canMove, stopped, detail::IsZero{});
+    vtkm::cont::ArrayHandle<vtkm::Id> order;
+    order.Allocate(numParticles);
+    vtkm::cont::Algorithm::CopySubRange(moving, 0, numMoving, order, 0);
+    vtkm::cont::Algorithm::CopySubRange(stopped, 0, numParticles - numMoving, order, numMoving);
+    this->Apply(history, order);
+    return numMoving;
+  }
+
+  // Puts the particles back in input order.
+  template <typename HistoryType>
+  VTKM_CONT
+  void Restore(HistoryType& history)
+  {
+    if(this->Original.GetNumberOfValues() == 0)
+      return;
+    vtkm::cont::ArrayHandle<vtkm::Id> order;
+    vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(this->Original.GetNumberOfValues()), order);
+    vtkm::cont::Algorithm::SortByKey(this->Original, order);
+    history.Permute(order);
+    this->Original.ReleaseResources();
+  }
+
+  VTKM_CONT
+  vtkm::Id GetNumberOfSorts() const { return this->NumberOfSorts; }
+
+  // Time spent sorting, in seconds.
+  VTKM_CONT
+  vtkm::Float64 GetSortTime() const { return this->SortTime; }
+
+  // MeanNeighbourDistance before and after the first sort.
+  VTKM_CONT
+  vtkm::FloatDefault GetInputDistance() const { return this->InputDistance; }
+  VTKM_CONT
+  vtkm::FloatDefault GetSortedDistance() const { return this->SortedDistance; }
+
+private:
+  template <typename HistoryType>
+  VTKM_CONT
+  void Apply(HistoryType& history, const vtkm::cont::ArrayHandle<vtkm::Id>& order)
+  {
+    if(this->Original.GetNumberOfValues() == 0)
+      vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(order.GetNumberOfValues()), this->Original);
+    history.Permute(order);
+    vtkm::cont::ArrayHandle<vtkm::Id> original;
+    vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandlePermutation(order, this->Original), original);
+    this->Original = original;
+  }
+
+  vtkm::Bounds Bounds;
+  // Input index of the particle in every slot, empty in input order.
+  vtkm::cont::ArrayHandle<vtkm::Id> Original;
+  vtkm::Id NumberOfSorts;
+  vtkm::Float64 SortTime;
+  vtkm::FloatDefault InputDistance;
+  vtkm::FloatDefault SortedDistance;
+};
+
+} // namespace locality
+
+#endif
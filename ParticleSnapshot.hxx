@@ -0,0 +1,452 @@
+#ifndef particle_snapshot_hxx
+#define particle_snapshot_hxx
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Types.h>
+#include <vtkm/VecTraits.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleBasic.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandleSOA.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/io/ErrorIO.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+/*
+ * Columnar binary particle snapshots.
+ *
+ * Layout (native endianness, all offsets in bytes from the start of file):
+ *   Header
+ *   Column[NumberOfColumns]
+ *   column data, each column starting on a ColumnAlignment boundary
+ *   optional block index: NumberOfBlocks x 6 Float64
+ *                         (xmin, xmax, ymin, ymax, zmin, zmax)
+ *
+ * Block i of the index bounds particles [i*BlockSize, (i+1)*BlockSize).
+ * Columns are stored as plain arrays so the reader can map the file and
+ * hand the columns out as ArrayHandles without copying.
+ */
+namespace snapshot
+{
+
+static const char Magic[8] = {'W', 'X', 'P', 'S', 'N', 'A', 'P', '\0'};
+static const vtkm::UInt32 Version = 1;
+static const vtkm::UInt64 ColumnAlignment = 64;
+
+struct Header
+{
+  char Magic[8];
+  vtkm::UInt32 Version;
+  vtkm::UInt32 NumberOfColumns;
+  vtkm::UInt64 NumberOfParticles;
+  vtkm::UInt64 BlockSize;
+  vtkm::UInt64 NumberOfBlocks;
+  vtkm::UInt64 IndexOffset;
+};
+
+struct Column
+{
+  char Name[32];
+  vtkm::UInt32 NumberOfComponents;
+  vtkm::UInt32 ComponentSize;
+  vtkm::UInt64 Offset;
+};
+
+namespace detail
+{
+
+class ComputeBlockBounds : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  ComputeBlockBounds(vtkm::Id blockSize)
+  : BlockSize(blockSize)
+  {
+  }
+
+  using ControlSignature = void(FieldIn, WholeArrayIn, FieldOut);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename PositionPortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id block,
+                  const PositionPortalType& positions,
+                  vtkm::Bounds& bounds) const
+  {
+    vtkm::Id begin = block * this->BlockSize;
+    vtkm::Id end = vtkm::Min(begin + this->BlockSize, positions.GetNumberOfValues());
+    bounds = vtkm::Bounds();
+    for(vtkm::Id i = begin; i < end; i++)
+      bounds.Include(positions.Get(i));
+  }
+
+private:
+  vtkm::Id BlockSize;
+};
+
+inline vtkm::UInt64 AlignOffset(vtkm::UInt64 offset)
+{
+  return (offset + ColumnAlignment - 1) / ColumnAlignment * ColumnAlignment;
+}
+
+} // namespace detail
+
+// Computes the bounds of every consecutive run of blockSize positions.
+template <typename PositionArrayType>
+void ComputeBlockBounds(const PositionArrayType& positions,
+                        vtkm::Id blockSize,
+                        std::vector<vtkm::Bounds>& blockBounds)
+{
+  vtkm::Id numBlocks = (positions.GetNumberOfValues() + blockSize - 1) / blockSize;
+  vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandle<vtkm::Bounds> bounds;
+  invoker(detail::ComputeBlockBounds(blockSize), vtkm::cont::ArrayHandleIndex(numBlocks), positions, bounds);
+  auto portal = bounds.ReadPortal();
+  blockBounds.resize(static_cast<std::size_t>(numBlocks));
+  for(vtkm::Id i = 0; i < numBlocks; i++)
+    blockBounds[static_cast<std::size_t>(i)] = portal.Get(i);
+}
+
+inline bool IsParticleSnapshot(const std::string& fileName)
+{
+  char magic[sizeof(Magic)];
+  FILE* file = fopen(fileName.c_str(), "rb");
+  if(file == nullptr)
+    return false;
+  bool isSnapshot = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                    memcmp(magic, Magic, sizeof(Magic)) == 0;
+  fclose(file);
+  return isSnapshot;
+}
+
+class ParticleSnapshotWriter
+{
+public:
+  ParticleSnapshotWriter(const std::string& fileName)
+  : FileName(fileName)
+  , NumberOfParticles(-1)
+  , BlockSize(0)
+  {}
+
+  void AddColumn(const std::string& name, const vtkm::cont::ArrayHandle<vtkm::FloatDefault>& data)
+  {
+    this->CheckColumn(name, data.GetNumberOfValues());
+    ColumnData column;
+    column.Name = name;
+    column.NumberOfComponents = 1;
+    column.Scalars = data;
+    this->Columns.push_back(column);
+  }
+
+  void AddColumn(const std::string& name, const vtkm::cont::ArrayHandle<vtkm::Vec3f>& data)
+  {
+    this->CheckColumn(name, data.GetNumberOfValues());
+    ColumnData column;
+    column.Name = name;
+    column.NumberOfComponents = 3;
+    column.Vectors = data;
+    this->Columns.push_back(column);
+  }
+
+  // Stores a bounding box for every blockSize particles so readers can
+  // skip blocks that cannot intersect a sampling region.
+  template <typename PositionArrayType>
+  void SetIndexPositions(const PositionArrayType& positions, vtkm::Id blockSize)
+  {
+    this->BlockSize = blockSize;
+    ComputeBlockBounds(positions, blockSize, this->BlockBounds);
+  }
+
+  void Write()
+  {
+    Header header;
+    memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = Version;
+    header.NumberOfColumns = static_cast<vtkm::UInt32>(this->Columns.size());
+    header.NumberOfParticles = static_cast<vtkm::UInt64>(vtkm::Max(this->NumberOfParticles, vtkm::Id(0)));
+    header.BlockSize = static_cast<vtkm::UInt64>(this->BlockSize);
+    header.NumberOfBlocks = this->BlockBounds.size();
+
+    std::vector<Column> columns(this->Columns.size());
+    vtkm::UInt64 offset = sizeof(Header) + columns.size() * sizeof(Column);
+    for(std::size_t i = 0; i < columns.size(); i++)
+    {
+      memset(columns[i].Name, 0, sizeof(columns[i].Name));
+      strncpy(columns[i].Name, this->Columns[i].Name.c_str(), sizeof(columns[i].Name) - 1);
+      columns[i].NumberOfComponents = this->Columns[i].NumberOfComponents;
+      columns[i].ComponentSize = sizeof(vtkm::FloatDefault);
+      columns[i].Offset = detail::AlignOffset(offset);
+      offset = columns[i].Offset +
+               header.NumberOfParticles * columns[i].NumberOfComponents * columns[i].ComponentSize;
+    }
+    header.IndexOffset = header.NumberOfBlocks > 0 ? detail::AlignOffset(offset) : 0;
+
+    FILE* file = fopen(this->FileName.c_str(), "wb");
+    if(file == nullptr)
+      throw vtkm::io::ErrorIO("Could not open " + this->FileName + " for writing");
+    this->WriteValues(file, &header, sizeof(Header), 1);
+    this->WriteValues(file, columns.data(), sizeof(Column), columns.size());
+    for(std::size_t i = 0; i < columns.size(); i++)
+    {
+      this->Pad(file, columns[i].Offset);
+      vtkm::cont::Token token;
+      if(this->Columns[i].NumberOfComponents == 1)
+        this->WriteValues(file, this->Columns[i].Scalars.GetReadPointer(token),
+                          sizeof(vtkm::FloatDefault), header.NumberOfParticles);
+      else
+        this->WriteValues(file, this->Columns[i].Vectors.GetReadPointer(token),
+                          sizeof(vtkm::Vec3f), header.NumberOfParticles);
+    }
+    if(header.NumberOfBlocks > 0)
+    {
+      this->Pad(file, header.IndexOffset);
+      for(const auto& bounds : this->BlockBounds)
+      {
+        vtkm::Float64 extents[6] = {bounds.X.Min, bounds.X.Max,
+                                    bounds.Y.Min, bounds.Y.Max,
+                                    bounds.Z.Min, bounds.Z.Max};
+        this->WriteValues(file, extents, sizeof(vtkm::Float64), 6);
+      }
+    }
+    if(fclose(file) != 0)
+      throw vtkm::io::ErrorIO("Could not finish writing " + this->FileName);
+  }
+
+private:
+  struct ColumnData
+  {
+    std::string Name;
+    vtkm::UInt32 NumberOfComponents;
+    vtkm::cont::ArrayHandleBasic<vtkm::FloatDefault> Scalars;
+    vtkm::cont::ArrayHandleBasic<vtkm::Vec3f> Vectors;
+  };
+
+  void CheckColumn(const std::string& name, vtkm::Id numValues)
+  {
+    if(name.size() >= sizeof(Column::Name))
+      throw vtkm::io::ErrorIO("Snapshot column name too long : " + name);
+    if(this->NumberOfParticles >= 0 && this->NumberOfParticles != numValues)
+      throw vtkm::io::ErrorIO("Snapshot column " + name + " has the wrong number of values");
+    this->NumberOfParticles = numValues;
+  }
+
+  void Pad(FILE* file, vtkm::UInt64 offset)
+  {
+    static const char zeros[ColumnAlignment] = {0};
+    vtkm::UInt64 position = static_cast<vtkm::UInt64>(ftell(file));
+    if(offset > position)
+      this->WriteValues(file, zeros, 1, offset - position);
+  }
+
+  // Closes the file and throws on a short write, e.g. a full disk.
+  void WriteValues(FILE* file, const void* data, std::size_t size, vtkm::UInt64 count)
+  {
+    if(count > 0 && fwrite(data, size, static_cast<std::size_t>(count), file) != count)
+    {
+      fclose(file);
+      throw vtkm::io::ErrorIO("Could not write " + this->FileName);
+    }
+  }
+
+  std::string FileName;
+  vtkm::Id NumberOfParticles;
+  vtkm::Id BlockSize;
+  std::vector<ColumnData> Columns;
+  std::vector<vtkm::Bounds> BlockBounds;
+};
+
+// Maps a snapshot into memory.  The ArrayHandles returned for the columns
+// point straight into the mapping, so they (and any DataSet built from
+// them) must not outlive the reader.
+class ParticleSnapshotReader
+{
+public:
+  ParticleSnapshotReader()
+  : Mapping(nullptr)
+  , MappingSize(0)
+  , FileHeader()
+  {}
+
+  ParticleSnapshotReader(const std::string& fileName)
+  : ParticleSnapshotReader()
+  {
+    this->Open(fileName);
+  }
+
+  ~ParticleSnapshotReader() { this->Close(); }
+
+  ParticleSnapshotReader(const ParticleSnapshotReader&) = delete;
+  ParticleSnapshotReader& operator=(const ParticleSnapshotReader&) = delete;
+
+  void Open(const std::string& fileName)
+  {
+    this->Close();
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+      throw vtkm::io::ErrorIO("Could not open " + fileName);
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || static_cast<std::size_t>(fileStat.st_size) < sizeof(Header))
+    {
+      close(fd);
+      throw vtkm::io::ErrorIO("Not a particle snapshot : " + fileName);
+    }
+    this->MappingSize = static_cast<std::size_t>(fileStat.st_size);
+    // Private writable mapping so that a stray write portal on a column
+    // only touches a copy-on-write page instead of faulting.
+    void* mapping = mmap(nullptr, this->MappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+      throw vtkm::io::ErrorIO("Could not map " + fileName);
+    this->Mapping = static_cast<char*>(mapping);
+
+    memcpy(&this->FileHeader, this->Mapping, sizeof(Header));
+    if(memcmp(this->FileHeader.Magic, Magic, sizeof(Magic)) != 0 ||
+       this->FileHeader.Version != Version)
+    {
+      this->Close();
+      throw vtkm::io::ErrorIO("Not a particle snapshot : " + fileName);
+    }
+    this->CheckExtents(fileName);
+    this->Columns.resize(this->FileHeader.NumberOfColumns);
+    memcpy(this->Columns.data(), this->Mapping + sizeof(Header),
+           this->Columns.size() * sizeof(Column));
+
+    this->BlockBounds.clear();
+    const vtkm::Float64* index =
+      reinterpret_cast<const vtkm::Float64*>(this->Mapping + this->FileHeader.IndexOffset);
+    for(vtkm::UInt64 i = 0; i < this->FileHeader.NumberOfBlocks; i++, index += 6)
+      this->BlockBounds.push_back(vtkm::Bounds(index[0], index[1], index[2], index[3], index[4], index[5]));
+  }
+
+  void Close()
+  {
+    if(this->Mapping != nullptr)
+      munmap(this->Mapping, this->MappingSize);
+    this->Mapping = nullptr;
+    this->MappingSize = 0;
+    this->Columns.clear();
+    this->BlockBounds.clear();
+  }
+
+  vtkm::Id GetNumberOfParticles() const
+  {
+    return static_cast<vtkm::Id>(this->FileHeader.NumberOfParticles);
+  }
+
+  vtkm::Id GetBlockSize() const { return static_cast<vtkm::Id>(this->FileHeader.BlockSize); }
+  const std::vector<vtkm::Bounds>& GetBlockBounds() const { return this->BlockBounds; }
+
+  bool HasColumn(const std::string& name) const
+  {
+    return this->FindColumn(name) != nullptr;
+  }
+
+  template <typename T>
+  vtkm::cont::ArrayHandle<T> GetColumn(const std::string& name) const
+  {
+    using Traits = vtkm::VecTraits<T>;
+    const Column* column = this->FindColumn(name);
+    if(column == nullptr)
+      throw vtkm::io::ErrorIO("Snapshot has no column " + name);
+    if(column->NumberOfComponents != static_cast<vtkm::UInt32>(Traits::NUM_COMPONENTS) ||
+       column->ComponentSize != sizeof(typename Traits::ComponentType))
+      throw vtkm::io::ErrorIO("Snapshot column " + name + " has a different type");
+    const T* data = reinterpret_cast<const T*>(this->Mapping + column->Offset);
+    return vtkm::cont::make_ArrayHandle(data, this->GetNumberOfParticles(), vtkm::CopyFlag::Off);
+  }
+
+  // Exposes every column as a point field, mirroring what
+  // VTKDataSetReader produces for the particle VTK files.  A 3-component
+  // "Position" column, or else the x/y/z columns, become the coordinates.
+  vtkm::cont::DataSet ReadDataSet() const
+  {
+    vtkm::cont::DataSet dataset;
+    for(const auto& column : this->Columns)
+    {
+      std::string name(column.Name);
+      if(column.NumberOfComponents == 3)
+        dataset.AddPointField(name, this->GetColumn<vtkm::Vec3f>(name));
+      else
+        dataset.AddPointField(name, this->GetColumn<vtkm::FloatDefault>(name));
+    }
+    if(this->HasColumn("Position"))
+    {
+      dataset.AddCoordinateSystem(
+        vtkm::cont::CoordinateSystem("coords", this->GetColumn<vtkm::Vec3f>("Position")));
+    }
+    else if(this->HasColumn("x") && this->HasColumn("y") && this->HasColumn("z"))
+    {
+      vtkm::cont::ArrayHandleSOA<vtkm::Vec3f> positions;
+      positions.SetArray(0, this->GetColumn<vtkm::FloatDefault>("x"));
+      positions.SetArray(1, this->GetColumn<vtkm::FloatDefault>("y"));
+      positions.SetArray(2, this->GetColumn<vtkm::FloatDefault>("z"));
+      dataset.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", positions));
+    }
+    return dataset;
+  }
+
+private:
+  // Checks that the column table, every column and the block index lie
+  // inside the mapping, so a truncated or corrupt file throws instead of
+  // reading past the end.  Sizes are compared by division to stay clear
+  // of overflow on garbage headers.
+  void CheckExtents(const std::string& fileName)
+  {
+    const Header& header = this->FileHeader;
+    vtkm::UInt64 size = this->MappingSize;
+    bool valid = header.NumberOfColumns <= (size - sizeof(Header)) / sizeof(Column);
+    vtkm::UInt64 tableEnd = sizeof(Header) + vtkm::UInt64(header.NumberOfColumns) * sizeof(Column);
+    for(vtkm::UInt32 i = 0; valid && i < header.NumberOfColumns; i++)
+    {
+      Column column;
+      memcpy(&column, this->Mapping + sizeof(Header) + i * sizeof(Column), sizeof(Column));
+      vtkm::UInt64 valueSize = vtkm::UInt64(column.NumberOfComponents) * column.ComponentSize;
+      valid = column.Name[sizeof(column.Name) - 1] == '\0' && column.Offset >= tableEnd &&
+              column.Offset <= size && column.Offset % alignof(vtkm::Float64) == 0 &&
+              (valueSize == 0 || header.NumberOfParticles <= (size - column.Offset) / valueSize);
+    }
+    if(valid && header.NumberOfBlocks > 0)
+    {
+      const vtkm::UInt64 blockSize = 6 * sizeof(vtkm::Float64);
+      valid = header.IndexOffset >= tableEnd && header.IndexOffset <= size &&
+              header.IndexOffset % alignof(vtkm::Float64) == 0 &&
+              header.NumberOfBlocks <= (size - header.IndexOffset) / blockSize;
+    }
+    if(!valid)
+    {
+      this->Close();
+      throw vtkm::io::ErrorIO("Corrupt particle snapshot : " + fileName);
+    }
+  }
+
+  const Column* FindColumn(const std::string& name) const
+  {
+    for(const auto& column : this->Columns)
+    {
+      if(name == column.Name)
+        return &column;
+    }
+    return nullptr;
+  }
+
+  char* Mapping;
+  std::size_t MappingSize;
+  Header FileHeader;
+  std::vector<Column> Columns;
+  std::vector<vtkm::Bounds> BlockBounds;
+};
+
+} // namespace snapshot
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef seeding_seed_sampling_hxx
+#define seeding_seed_sampling_hxx
+
+#include <limits>
+
+#include <vtkm/Math.h>
+#include <vtkm/Pair.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/ArrayHandleRandomUniformReal.h>
+#include <vtkm/cont/ArrayHandleTransform.h>
+#include <vtkm/cont/ArrayHandleView.h>
+#include <vtkm/cont/ArrayHandleZip.h>
+
+#include "Config.h"
+
+namespace seeding
+{
+
+namespace detail
+{
+
+// Exponential key of a weighted draw (Efraimidis-Spirakis).  Keeping the
+// particles with the k smallest keys samples k of them without
+// replacement, with probability proportional to their weight.  Particles
+// without a positive weight can never be drawn.
+struct SamplingKey
+{
+  template <typename WeightType>
+  VTKM_EXEC_CONT
+  vtkm::Float64 operator()(const vtkm::Pair<vtkm::Float64, WeightType>& draw) const
+  {
+    vtkm::Float64 weight = static_cast<vtkm::Float64>(draw.second);
+    if(!(weight > 0))
+      return vtkm::Infinity64();
+    return -vtkm::Log1P(-draw.first) / weight;
+  }
+};
+
+struct BelowThreshold
+{
+  VTKM_EXEC_CONT
+  BelowThreshold(vtkm::Float64 threshold = 0)
+  : Threshold(threshold)
+  {}
+
+  template <typename WeightType>
+  VTKM_EXEC_CONT
+  vtkm::Id operator()(const vtkm::Pair<vtkm::Float64, WeightType>& draw) const
+  {
+    return SamplingKey{}(draw) < this->Threshold ? 1 : 0;
+  }
+
+  vtkm::Float64 Threshold;
+};
+
+struct SecondOf
+{
+  template <typename PairType>
+  VTKM_EXEC_CONT
+  vtkm::Id operator()(const PairType& pair) const
+  {
+    return pair.second;
+  }
+};
+
+} // namespace detail
+
+/*
+ * Draws `numberOfSamples` distinct indices out of `weights.GetNumberOfValues()`
+ * with probability proportional to the weights.  Random numbers come from
+ * the counter-based (Philox) ArrayHandleRandomUniformReal, so every index
+ * gets the same draw for a given seed regardless of device or thread count,
+ * and ties are broken by index.  Only the candidates below a key threshold
+ * are materialized and sorted, so the cost stays linear in the number of
+ * electrons.  The selected indices are returned in ascending order.
+ */
+template <typename WeightArrayType>
+void SampleIndices(vtkm::Id numberOfSamples,
+                   const WeightArrayType& weights,
+                   vtkm::UInt32 seed,
+                   vtkm::cont::ArrayHandle<vtkm::Id>& selected)
+{
+  using Algorithm = vtkm::cont::Algorithm;
+  vtkm::Id total = weights.GetNumberOfValues();
+  vtkm::cont::ArrayHandleRandomUniformReal<vtkm::Float64> uniform(total, { seed });
+  auto draws = vtkm::cont::make_ArrayHandleZip(uniform, weights);
+  auto countBelow = [&](vtkm::Float64 threshold) {
+    auto below = vtkm::cont::make_ArrayHandleTransform(draws, detail::BelowThreshold(threshold));
+    return Algorithm::Reduce(below, static_cast<vtkm::Id>(0));
+  };
+
+  vtkm::Id available = countBelow(vtkm::Infinity64());
+  numberOfSamples = vtkm::Min(numberOfSamples, available);
+  if(numberOfSamples <= 0)
+  {
+    selected.Allocate(0);
+    return;
+  }
+
+  // Pick the threshold so that about 1.25k keys fall below it for the
+  // mean weight, and double it on the rare occasions it falls short.
+  vtkm::Float64 meanWeight =
+    Algorithm::Reduce(weights, static_cast<vtkm::Float64>(0)) / static_cast<vtkm::Float64>(available);
+  vtkm::Float64 fraction = 1.25 * static_cast<vtkm::Float64>(numberOfSamples) / available;
+  vtkm::Float64 threshold = fraction < 1 ? -vtkm::Log1P(-fraction) / meanWeight : vtkm::Infinity64();
+  while(countBelow(threshold) < numberOfSamples)
+    threshold = vtkm::Max(2 * threshold, std::numeric_limits<vtkm::Float64>::min());
+
+  vtkm::cont::ArrayHandle<vtkm::Id> candidates;
+  Algorithm::CopyIf(vtkm::cont::ArrayHandleIndex(total),
+                    vtkm::cont::make_ArrayHandleTransform(draws, detail::BelowThreshold(threshold)),
+                    candidates);
+  auto keys = vtkm::cont::make_ArrayHandleTransform(draws, detail::SamplingKey{});
+  vtkm::cont::ArrayHandle<vtkm::Pair<vtkm::Float64, vtkm::Id>> ranked;
+  vtkm::cont::ArrayCopy(
+    vtkm::cont::make_ArrayHandleZip(vtkm::cont::make_ArrayHandlePermutation(candidates, keys), candidates),
+    ranked);
+  Algorithm::Sort(ranked);
+
+  auto kept = vtkm::cont::make_ArrayHandleView(ranked, 0, numberOfSamples);
+  vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleTransform(kept, detail::SecondOf{}), selected);
+  Algorithm::Sort(selected);
+}
+
+// Uniform sampling without replacement.
+inline void SampleIndices(vtkm::Id numberOfSamples,
+                   vtkm::Id total,
+                   vtkm::UInt32 seed,
+                   vtkm::cont::ArrayHandle<vtkm::Id>& selected)
+{
+  SampleIndices(numberOfSamples,
+                vtkm::cont::make_ArrayHandleConstant(vtkm::FloatDefault(1), total),
+                seed,
+                selected);
+}
+
+// Samples the number of seeds requested in the config out of the
+// `candidates` indices, uniformly or weighted by `weights`, which is
+// indexed like the species and not like the candidates.
+template <typename WeightArrayType>
+void SampleSeeds(const config::Config& config,
+                 const vtkm::cont::ArrayHandle<vtkm::Id>& candidates,
+                 const WeightArrayType& weights,
+                 vtkm::cont::ArrayHandle<vtkm::Id>& seeds)
+{
+  vtkm::cont::ArrayHandle<vtkm::Id> toKeep;
+  if(config.GetSamplingOption() == config::SamplingOption::WEIGHTED)
+  {
+    auto candidateWeights = vtkm::cont::make_ArrayHandlePermutation(candidates, weights);
+    SampleIndices(config.GetNumSeeds(), candidateWeights, config.GetSamplingSeed(), toKeep);
+  }
+  else
+  {
+    SampleIndices(config.GetNumSeeds(), candidates.GetNumberOfValues(), config.GetSamplingSeed(), toKeep);
+  }
+  vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandlePermutation(toKeep, candidates), seeds);
+}
+
+} // namespace seeding
+
+#endif
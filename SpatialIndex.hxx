@@ -0,0 +1,268 @@
+#ifndef seeding_spatial_index_hxx
+#define seeding_spatial_index_hxx
+
+#include <vector>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "ParticleSnapshot.hxx"
+
+namespace seeding
+{
+
+namespace detail
+{
+
+class MortonKey : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  MortonKey(const vtkm::Bounds& bounds)
+  : Origin(bounds.X.Min, bounds.Y.Min, bounds.Z.Min)
+  {
+    constexpr vtkm::FloatDefault cells = static_cast<vtkm::FloatDefault>((1 << 21) - 1);
+    this->Scale = vtkm::Vec3f(bounds.X.Length() > 0 ? cells / bounds.X.Length() : 0,
+                              bounds.Y.Length() > 0 ? cells / bounds.Y.Length() : 0,
+                              bounds.Z.Length() > 0 ? cells / bounds.Z.Length() : 0);
+  }
+
+  using ControlSignature = void(FieldIn, FieldOut);
+  using ExecutionSignature = void(_1, _2);
+
+  template <typename PointType>
+  VTKM_EXEC
+  void operator()(const PointType& point, vtkm::UInt64& key) const
+  {
+    key = 0;
+    for(vtkm::IdComponent axis = 0; axis < 3; axis++)
+    {
+      vtkm::FloatDefault scaled = (point[axis] - this->Origin[axis]) * this->Scale[axis];
+      vtkm::UInt64 cell = static_cast<vtkm::UInt64>(
+        vtkm::Min(vtkm::Max(scaled, vtkm::FloatDefault(0)), vtkm::FloatDefault((1 << 21) - 1)));
+      key |= Spread(cell) << axis;
+    }
+  }
+
+private:
+  // Spreads the lower 21 bits of value so they occupy every third bit.
+  VTKM_EXEC
+  static vtkm::UInt64 Spread(vtkm::UInt64 value)
+  {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8)  & 0x100f00f00f00f00fULL;
+    value = (value | value << 4)  & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2)  & 0x1249249249249249ULL;
+    return value;
+  }
+
+  vtkm::Vec3f Origin;
+  vtkm::Vec3f Scale;
+};
+
+class ExpandBlocks : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  ExpandBlocks(vtkm::Id blockSize, vtkm::Id numberOfParticles)
+  : BlockSize(blockSize)
+  , NumberOfParticles(numberOfParticles)
+  {
+  }
+
+  using ControlSignature = void(FieldIn, FieldIn, WholeArrayOut);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename SlotPortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id block,
+                  const vtkm::Id outOffset,
+                  SlotPortalType& slots) const
+  {
+    vtkm::Id begin = block * this->BlockSize;
+    vtkm::Id end = vtkm::Min(begin + this->BlockSize, this->NumberOfParticles);
+    for(vtkm::Id slot = begin; slot < end; slot++)
+      slots.Set(outOffset + slot - begin, slot);
+  }
+
+private:
+  vtkm::Id BlockSize;
+  vtkm::Id NumberOfParticles;
+};
+
+class InsideBounds : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  InsideBounds(const vtkm::Bounds& bounds)
+  : Bounds(bounds)
+  {
+  }
+
+  using ControlSignature = void(FieldIn, WholeArrayIn, FieldOut);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename PositionPortalType>
+  VTKM_EXEC
+  void operator()(const vtkm::Id index,
+                  const PositionPortalType& positions,
+                  vtkm::UInt8& inside) const
+  {
+    inside = this->Bounds.Contains(positions.Get(index)) ? 1 : 0;
+  }
+
+private:
+  vtkm::Bounds Bounds;
+};
+
+inline bool Intersects(const vtkm::Bounds& a, const vtkm::Bounds& b)
+{
+  return a.X.Min <= b.X.Max && b.X.Min <= a.X.Max &&
+         a.Y.Min <= b.Y.Max && b.Y.Min <= a.Y.Max &&
+         a.Z.Min <= b.Z.Max && b.Z.Min <= a.Z.Max;
+}
+
+} // namespace detail
+
+/*
+ * Coarse spatial index over particle positions.  Particles are grouped in
+ * blocks of BlockSize consecutive entries (in file order, or in Z-order
+ * after BuildSorted) and every block keeps its bounding box.  Queries only
+ * visit the particles of blocks whose box overlaps the query region and
+ * return the matching particle indices in ascending order, which is the
+ * same set and order a full scan with Bounds::Contains produces.
+ */
+class BlockIndex
+{
+public:
+  BlockIndex()
+  : BlockSize(0)
+  , NumberOfParticles(0)
+  {}
+
+  // Indexes the positions in their current order.
+  template <typename PositionArrayType>
+  void Build(const PositionArrayType& positions, vtkm::Id blockSize)
+  {
+    this->BlockSize = blockSize;
+    this->NumberOfParticles = positions.GetNumberOfValues();
+    this->Order.ReleaseResources();
+    snapshot::ComputeBlockBounds(positions, blockSize, this->BlockBounds);
+  }
+
+  // Indexes the positions after sorting them along a Morton curve, which
+  // gives tight blocks even when the file order is spatially incoherent.
+  template <typename PositionArrayType>
+  void BuildSorted(const PositionArrayType& positions, vtkm::Id blockSize)
+  {
+    this->Build(positions, blockSize);
+    vtkm::Bounds bounds;
+    for(const auto& blockBounds : this->BlockBounds)
+      bounds.Include(blockBounds);
+
+    vtkm::cont::Invoker invoker;
+    vtkm::cont::ArrayHandle<vtkm::UInt64> keys;
+    invoker(detail::MortonKey(bounds), positions, keys);
+    vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(this->NumberOfParticles), this->Order);
+    vtkm::cont::Algorithm::SortByKey(keys, this->Order);
+
+    auto sorted = vtkm::cont::make_ArrayHandlePermutation(this->Order, positions);
+    snapshot::ComputeBlockBounds(sorted, blockSize, this->BlockBounds);
+  }
+
+  // Reuses the block index stored in a particle snapshot.
+  void SetBlocks(const std::vector<vtkm::Bounds>& blockBounds,
+                 vtkm::Id blockSize,
+                 vtkm::Id numberOfParticles)
+  {
+    this->BlockBounds = blockBounds;
+    this->BlockSize = blockSize;
+    this->NumberOfParticles = numberOfParticles;
+    this->Order.ReleaseResources();
+  }
+
+  bool IsValid() const { return this->BlockSize > 0; }
+  vtkm::Id GetBlockSize() const { return this->BlockSize; }
+  vtkm::Id GetNumberOfBlocks() const { return static_cast<vtkm::Id>(this->BlockBounds.size()); }
+  const std::vector<vtkm::Bounds>& GetBlockBounds() const { return this->BlockBounds; }
+
+  // Returns the indices of all particles inside `bounds` (inclusive).
+  template <typename PositionArrayType>
+  void QueryBox(const PositionArrayType& positions,
+                const vtkm::Bounds& bounds,
+                vtkm::cont::ArrayHandle<vtkm::Id>& selected) const
+  {
+    std::vector<vtkm::Id> blocks;
+    std::vector<vtkm::Id> counts;
+    for(std::size_t block = 0; block < this->BlockBounds.size(); block++)
+    {
+      if(!detail::Intersects(this->BlockBounds[block], bounds))
+        continue;
+      vtkm::Id begin = static_cast<vtkm::Id>(block) * this->BlockSize;
+      blocks.push_back(static_cast<vtkm::Id>(block));
+      counts.push_back(vtkm::Min(this->BlockSize, this->NumberOfParticles - begin));
+    }
+
+    vtkm::cont::Invoker invoker;
+    auto blockArray = vtkm::cont::make_ArrayHandle(blocks, vtkm::CopyFlag::Off);
+    auto countArray = vtkm::cont::make_ArrayHandle(counts, vtkm::CopyFlag::Off);
+    vtkm::cont::ArrayHandle<vtkm::Id> offsets;
+    vtkm::Id numCandidates = vtkm::cont::Algorithm::ScanExclusive(countArray, offsets);
+
+    vtkm::cont::ArrayHandle<vtkm::Id> candidates;
+    candidates.Allocate(numCandidates);
+    invoker(detail::ExpandBlocks(this->BlockSize, this->NumberOfParticles), blockArray, offsets, candidates);
+    if(this->Order.GetNumberOfValues() > 0)
+    {
+      vtkm::cont::ArrayHandle<vtkm::Id> unsorted;
+      vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandlePermutation(candidates, this->Order), unsorted);
+      candidates = unsorted;
+    }
+
+    vtkm::cont::ArrayHandle<vtkm::UInt8> inside;
+    invoker(detail::InsideBounds(bounds), candidates, positions, inside);
+    vtkm::cont::Algorithm::CopyIf(candidates, inside, selected);
+    if(this->Order.GetNumberOfValues() > 0)
+      vtkm::cont::Algorithm::Sort(selected);
+  }
+
+  // Returns the indices of all particles whose coordinate along `axis`
+  // lies within `range`.
+  template <typename PositionArrayType>
+  void QuerySlab(const PositionArrayType& positions,
+                 vtkm::IdComponent axis,
+                 const vtkm::Range& range,
+                 vtkm::cont::ArrayHandle<vtkm::Id>& selected) const
+  {
+    vtkm::Range everything(vtkm::NegativeInfinity64(), vtkm::Infinity64());
+    vtkm::Bounds bounds(everything, everything, everything);
+    if(axis == 0)
+      bounds.X = range;
+    else if(axis == 1)
+      bounds.Y = range;
+    else
+      bounds.Z = range;
+    this->QueryBox(positions, bounds, selected);
+  }
+
+private:
+  vtkm::Id BlockSize;
+  vtkm::Id NumberOfParticles;
+  std::vector<vtkm::Bounds> BlockBounds;
+  // Slot -> particle index when the index was built in Morton order.
+  vtkm::cont::ArrayHandle<vtkm::Id> Order;
+};
+
+} // namespace seeding
+
+#endif
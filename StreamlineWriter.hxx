@@ -0,0 +1,304 @@
+#ifndef streams_streamline_writer_hxx
+#define streams_streamline_writer_hxx
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleBasic.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/io/ErrorIO.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "Config.h"
+#include "Instrumentation.h"
+
+/*
+ * Streaming writers for streamlines recorded by
+ * history::ChunkedStateRecordingParticles.
+ *
+ * The history is compacted one range of particles at a time, and every
+ * range is written out before the next one is gathered.  Besides the
+ * per-particle point counts only about ChunkPoints points are in memory,
+ * however long the output.  The connectivity of the polylines is the
+ * identity, so it is never built: the legacy VTK writer generates the
+ * LINES section on the fly and the raw format only stores offsets.
+ *
+ * Raw layout (native endianness, all offsets in bytes from the start of file):
+ *   Header
+ *   line offsets : (NumberOfLines + 1) x Int64, into the point columns
+ *   x, y, z      : NumberOfPoints x ComponentSize each
+ */
+namespace streams
+{
+
+static const char Magic[8] = {'W', 'X', 'S', 'T', 'R', 'M', 'S', '\0'};
+static const vtkm::UInt32 Version = 1;
+static const vtkm::Id ChunkPoints = 1 << 20;
+
+struct Header
+{
+  char Magic[8];
+  vtkm::UInt32 Version;
+  vtkm::UInt32 ComponentSize;
+  vtkm::UInt64 NumberOfLines;
+  vtkm::UInt64 NumberOfPoints;
+};
+
+namespace detail
+{
+
+inline bool IsLittleEndian()
+{
+  const vtkm::UInt16 one = 1;
+  return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+template <typename T>
+VTKM_EXEC_CONT T SwapBytes(T value)
+{
+  T swapped;
+  const char* in = reinterpret_cast<const char*>(&value);
+  char* out = reinterpret_cast<char*>(&swapped);
+  for(std::size_t i = 0; i < sizeof(T); i++)
+    out[i] = in[sizeof(T) - 1 - i];
+  return swapped;
+}
+
+// Legacy VTK binary data is big-endian.  Swaps every component of the
+// points on the device, so the whole chunk can be written at once.
+class SwapPointBytes : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn, FieldOut);
+  using ExecutionSignature = void(_1, _2);
+
+  VTKM_EXEC
+  void operator()(const vtkm::Vec3f& point, vtkm::Vec3f& swapped) const
+  {
+    for(vtkm::IdComponent c = 0; c < 3; c++)
+      swapped[c] = SwapBytes(point[c]);
+  }
+};
+
+template <typename T>
+void SwapBuffer(std::vector<T>& values)
+{
+  for(auto& value : values)
+    value = SwapBytes(value);
+}
+
+inline FILE* OpenFile(const std::string& fileName)
+{
+  FILE* file = fopen(fileName.c_str(), "wb");
+  if(file == nullptr)
+    throw vtkm::io::ErrorIO("Could not open " + fileName + " for writing");
+  return file;
+}
+
+// fwrite that closes the file and throws on a short write.
+inline void Write(FILE* file, const void* data, std::size_t size, std::size_t count, const std::string& fileName)
+{
+  if(count > 0 && fwrite(data, size, count, file) != count)
+  {
+    fclose(file);
+    throw vtkm::io::ErrorIO("Could not write " + fileName);
+  }
+}
+
+inline void Seek(FILE* file, off_t offset, const std::string& fileName)
+{
+  if(fseeko(file, offset, SEEK_SET) != 0)
+  {
+    fclose(file);
+    throw vtkm::io::ErrorIO("Could not seek in " + fileName);
+  }
+}
+
+// Also catches the errors of the buffered writes and of fprintf.
+inline void Close(FILE* file, const std::string& fileName)
+{
+  bool failed = ferror(file) != 0;
+  if(fclose(file) != 0 || failed)
+    throw vtkm::io::ErrorIO("Could not finish writing " + fileName);
+}
+
+// Splits the particles into consecutive ranges of at most chunkPoints
+// points.  A range always holds at least one particle, so a single line
+// longer than chunkPoints gets a range of its own.
+inline void SplitRanges(const vtkm::cont::ArrayHandle<vtkm::Id>& numPoints,
+                        vtkm::Id chunkPoints,
+                        std::vector<vtkm::Id>& ranges)
+{
+  auto portal = numPoints.ReadPortal();
+  ranges.assign(1, 0);
+  vtkm::Id points = 0;
+  for(vtkm::Id i = 0; i < portal.GetNumberOfValues(); i++)
+  {
+    if(points > 0 && points + portal.Get(i) > chunkPoints)
+    {
+      ranges.push_back(i);
+      points = 0;
+    }
+    points += portal.Get(i);
+  }
+  ranges.push_back(portal.GetNumberOfValues());
+}
+
+} // namespace detail
+
+// Legacy VTK POLYDATA with one polyline per particle, in binary.
+template <typename HistoryType>
+void WriteLegacyVTK(const HistoryType& history,
+                    const std::string& fileName,
+                    vtkm::Id chunkPoints = ChunkPoints)
+{
+  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+  history.GetNumberOfPoints(numPoints);
+  vtkm::Id numLines = numPoints.GetNumberOfValues();
+  vtkm::Id total = vtkm::cont::Algorithm::Reduce(numPoints, static_cast<vtkm::Id>(0));
+  if(numLines + total > std::numeric_limits<vtkm::Int32>::max())
+    throw vtkm::io::ErrorIO("Too many points for the 32 bit ids of legacy VTK : " + fileName);
+
+  const char* typeName = std::is_same<vtkm::FloatDefault, vtkm::Float64>::value ? "double" : "float";
+  FILE* file = detail::OpenFile(fileName);
+  fprintf(file, "# vtk DataFile Version 3.0\nstreamlines\nBINARY\nDATASET POLYDATA\n");
+  fprintf(file, "POINTS %lld %s\n", static_cast<long long>(total), typeName);
+
+  std::vector<vtkm::Id> ranges;
+  detail::SplitRanges(numPoints, chunkPoints, ranges);
+  bool swap = detail::IsLittleEndian();
+  vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+  vtkm::cont::ArrayHandleBasic<vtkm::Vec3f> swapped;
+  for(std::size_t range = 0; range + 1 < ranges.size(); range++)
+  {
+    history.GetHistory(ranges[range], ranges[range + 1] - ranges[range], points);
+    if(swap)
+      invoker(detail::SwapPointBytes{}, points, swapped);
+    else
+      swapped = points;
+    vtkm::cont::Token token;
+    detail::Write(file, swapped.GetReadPointer(token), sizeof(vtkm::Vec3f),
+                  static_cast<std::size_t>(swapped.GetNumberOfValues()), fileName);
+  }
+
+  // Point ids of every line are consecutive.  Each range of lines is laid
+  // out in native order, swapped in place and written in one go.
+  fprintf(file, "\nLINES %lld %lld\n", static_cast<long long>(numLines),
+          static_cast<long long>(numLines + total));
+  auto portal = numPoints.ReadPortal();
+  std::vector<vtkm::Int32> buffer;
+  vtkm::Int32 pointId = 0;
+  for(std::size_t range = 0; range + 1 < ranges.size(); range++)
+  {
+    buffer.clear();
+    for(vtkm::Id line = ranges[range]; line < ranges[range + 1]; line++)
+    {
+      vtkm::Int32 count = static_cast<vtkm::Int32>(portal.Get(line));
+      buffer.push_back(count);
+      for(vtkm::Int32 i = 0; i < count; i++)
+        buffer.push_back(pointId++);
+    }
+    if(swap)
+      detail::SwapBuffer(buffer);
+    detail::Write(file, buffer.data(), sizeof(vtkm::Int32), buffer.size(), fileName);
+  }
+  fprintf(file, "\n");
+  detail::Close(file, fileName);
+}
+
+// Raw columnar streamlines, see the layout above.
+template <typename HistoryType>
+void WriteRaw(const HistoryType& history,
+              const std::string& fileName,
+              vtkm::Id chunkPoints = ChunkPoints)
+{
+  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+  history.GetNumberOfPoints(numPoints);
+  vtkm::Id numLines = numPoints.GetNumberOfValues();
+
+  // Offsets are written as they are accumulated.
+  FILE* file = detail::OpenFile(fileName);
+  Header header;
+  memcpy(header.Magic, Magic, sizeof(Magic));
+  header.Version = Version;
+  header.ComponentSize = sizeof(vtkm::FloatDefault);
+  header.NumberOfLines = static_cast<vtkm::UInt64>(numLines);
+  header.NumberOfPoints = 0;
+  detail::Write(file, &header, sizeof(Header), 1, fileName);
+  std::vector<vtkm::Int64> offsets;
+  offsets.reserve(static_cast<std::size_t>(vtkm::Min(numLines + 1, chunkPoints)));
+  offsets.push_back(0);
+  auto portal = numPoints.ReadPortal();
+  vtkm::Int64 total = 0;
+  for(vtkm::Id line = 0; line < numLines; line++)
+  {
+    total += portal.Get(line);
+    offsets.push_back(total);
+    if(static_cast<vtkm::Id>(offsets.size()) >= chunkPoints)
+    {
+      detail::Write(file, offsets.data(), sizeof(vtkm::Int64), offsets.size(), fileName);
+      offsets.clear();
+    }
+  }
+  detail::Write(file, offsets.data(), sizeof(vtkm::Int64), offsets.size(), fileName);
+  header.NumberOfPoints = static_cast<vtkm::UInt64>(total);
+  detail::Seek(file, 0, fileName);
+  detail::Write(file, &header, sizeof(Header), 1, fileName);
+
+  // Every range of lines fills its slice of each of the three columns.
+  off_t columns = static_cast<off_t>(sizeof(Header) + (numLines + 1) * sizeof(vtkm::Int64));
+  std::vector<vtkm::Id> ranges;
+  detail::SplitRanges(numPoints, chunkPoints, ranges);
+  std::vector<vtkm::FloatDefault> component;
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+  vtkm::Int64 start = 0;
+  for(std::size_t range = 0; range + 1 < ranges.size(); range++)
+  {
+    history.GetHistory(ranges[range], ranges[range + 1] - ranges[range], points);
+    auto pointPortal = points.ReadPortal();
+    vtkm::Id count = pointPortal.GetNumberOfValues();
+    component.resize(static_cast<std::size_t>(count));
+    for(vtkm::IdComponent c = 0; c < 3; c++)
+    {
+      for(vtkm::Id i = 0; i < count; i++)
+        component[static_cast<std::size_t>(i)] = pointPortal.Get(i)[c];
+      detail::Seek(file, columns + static_cast<off_t>((c * total + start) * sizeof(vtkm::FloatDefault)), fileName);
+      detail::Write(file, component.data(), sizeof(vtkm::FloatDefault), component.size(), fileName);
+    }
+    start += count;
+  }
+  detail::Close(file, fileName);
+}
+
+inline std::string GetFileName(const std::string& baseName, config::StreamFormat format)
+{
+  return baseName + (format == config::StreamFormat::RAW ? ".wxsl" : ".vtk");
+}
+
+template <typename HistoryType>
+void WriteStreamlines(const HistoryType& history,
+                      const std::string& baseName,
+                      config::StreamFormat format)
+{
+  instrumentation::Scope scope("Write");
+  scope.SetCount(history.GetParticles().GetNumberOfValues());
+  if(format == config::StreamFormat::RAW)
+    WriteRaw(history, GetFileName(baseName, format));
+  else
+    WriteLegacyVTK(history, GetFileName(baseName, format));
+}
+
+} // namespace streams
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef synthetic_fields_hxx
+#define synthetic_fields_hxx
+
+#include <string>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleGroupVec.h>
+#include <vtkm/cont/ArrayHandleRandomUniformReal.h>
+#include <vtkm/cont/ArrayHandleSOA.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/DataSetBuilderUniform.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "FieldSeries.hxx"
+
+/*
+ * Analytic E/B fields on uniform grids and electron beams in the layout of
+ * a WarpX species file, so the advection, seeding and filtering paths can
+ * be run without the WarpX datasets.  Everything is generated from the
+ * arguments and a random seed, so runs are reproducible.
+ */
+namespace synthetic
+{
+
+enum class FieldShape
+{
+  CONSTANT, // Uniform B along z, E along x.
+  DIPOLE,   // Magnetic dipole along z at the center of the grid.
+  ROTATING, // B turning once around z over the length of the grid.
+};
+
+// Returns false for an unknown name.
+inline bool ParseFieldShape(const std::string& name, FieldShape& shape)
+{
+  if(name == "constant")
+    shape = FieldShape::CONSTANT;
+  else if(name == "dipole")
+    shape = FieldShape::DIPOLE;
+  else if(name == "rotating")
+    shape = FieldShape::ROTATING;
+  else
+    return false;
+  return true;
+}
+
+inline std::string GetFieldShapeName(FieldShape shape)
+{
+  switch(shape)
+  {
+    case FieldShape::CONSTANT:
+      return "constant";
+    case FieldShape::DIPOLE:
+      return "dipole";
+    default:
+      return "rotating";
+  }
+}
+
+// Extent of the generated grids.  With fields of the order of
+// FIELD_STRENGTH, electrons of the beam gyrate on a few grid cells.
+constexpr static vtkm::FloatDefault DOMAIN_SIZE = static_cast<vtkm::FloatDefault>(1e-4);
+constexpr static vtkm::FloatDefault FIELD_STRENGTH = static_cast<vtkm::FloatDefault>(1e2);
+constexpr static vtkm::FloatDefault ELECTRON_MASS = static_cast<vtkm::FloatDefault>(9.1093837e-31);
+constexpr static vtkm::FloatDefault ELECTRON_CHARGE = static_cast<vtkm::FloatDefault>(-1.60217663e-19);
+
+inline vtkm::Bounds GetDomainBounds()
+{
+  vtkm::Float64 half = DOMAIN_SIZE / 2;
+  return vtkm::Bounds(-half, half, -half, half, 0, DOMAIN_SIZE);
+}
+
+namespace detail
+{
+
+class EvaluateShape : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  EvaluateShape(FieldShape shape, const vtkm::Bounds& bounds, vtkm::FloatDefault coreRadius)
+  : Shape(shape)
+  , Center(bounds.Center())
+  , Length(static_cast<vtkm::FloatDefault>(bounds.Z.Length()))
+  , CoreRadius(coreRadius)
+  {}
+
+  using ControlSignature = void(FieldIn point, FieldOut electric, FieldOut magnetic);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  template <typename PointType>
+  VTKM_EXEC void operator()(const PointType& point, vtkm::Vec3f& electric, vtkm::Vec3f& magnetic) const
+  {
+    const vtkm::FloatDefault E0 = FIELD_STRENGTH * static_cast<vtkm::FloatDefault>(1e5);
+    if(this->Shape == FieldShape::CONSTANT)
+    {
+      electric = vtkm::Vec3f(E0, 0, 0);
+      magnetic = vtkm::Vec3f(0, 0, FIELD_STRENGTH);
+    }
+    else if(this->Shape == FieldShape::DIPOLE)
+    {
+      // Softened inside the core, where the field is FIELD_STRENGTH.
+      vtkm::Vec3f r = vtkm::Vec3f(point) - this->Center;
+      vtkm::FloatDefault distance = vtkm::Max(vtkm::Magnitude(r), this->CoreRadius);
+      vtkm::Vec3f unit = r / distance;
+      vtkm::FloatDefault scale = this->CoreRadius / distance;
+      const vtkm::Vec3f moment(0, 0, 1);
+      electric = vtkm::Vec3f(0, 0, 0);
+      magnetic = FIELD_STRENGTH * scale * scale * scale * (3 * vtkm::Dot(moment, unit) * unit - moment);
+    }
+    else
+    {
+      vtkm::FloatDefault angle = vtkm::TwoPi<vtkm::FloatDefault>() * static_cast<vtkm::FloatDefault>(point[2]) / this->Length;
+      electric = E0 * vtkm::Vec3f(-vtkm::Sin(angle), vtkm::Cos(angle), 0);
+      magnetic = FIELD_STRENGTH * vtkm::Vec3f(vtkm::Cos(angle), vtkm::Sin(angle), 0);
+    }
+  }
+
+private:
+  FieldShape Shape;
+  vtkm::Vec3f Center;
+  vtkm::FloatDefault Length;
+  vtkm::FloatDefault CoreRadius;
+};
+
+// Electrons spread uniformly over a box of `Spread` around the center,
+// with normalized transverse momenta in [-0.5, 0.5] and longitudinal ones
+// in [-0.1, 0.1].  Weights are in [1, 2] so weighted sampling differs
+// from uniform sampling.
+class MakeElectron : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  MakeElectron(const vtkm::Bounds& bounds, vtkm::FloatDefault spread)
+  : Center(bounds.Center())
+  , Spread(spread)
+  {}
+
+  using ControlSignature = void(FieldIn random, FieldOut position, FieldOut momentum, FieldOut weighting);
+  using ExecutionSignature = void(_1, _2, _3, _4);
+
+  template <typename RandomVecType>
+  VTKM_EXEC void operator()(const RandomVecType& random,
+                            vtkm::Vec3f& position,
+                            vtkm::Vec3f& momentum,
+                            vtkm::FloatDefault& weighting) const
+  {
+    for(vtkm::IdComponent i = 0; i < 3; i++)
+      position[i] = this->Center[i] + this->Spread * static_cast<vtkm::FloatDefault>(random[i] - 0.5);
+    momentum = vtkm::Vec3f(static_cast<vtkm::FloatDefault>(random[3] - 0.5),
+                           static_cast<vtkm::FloatDefault>(random[4] - 0.5),
+                           static_cast<vtkm::FloatDefault>(0.2 * (random[5] - 0.5)));
+    weighting = static_cast<vtkm::FloatDefault>(1 + random[6]);
+  }
+
+private:
+  vtkm::Vec3f Center;
+  vtkm::FloatDefault Spread;
+};
+
+} // namespace detail
+
+// E and B of `shape` on a grid of `dims` points over GetDomainBounds().
+inline temporal::FieldSnapshot MakeFields(FieldShape shape, const vtkm::Id3& dims)
+{
+  vtkm::Bounds bounds = GetDomainBounds();
+  vtkm::Vec3f origin(vtkm::Vec3f(bounds.MinCorner()));
+  vtkm::Vec3f spacing(static_cast<vtkm::FloatDefault>(bounds.X.Length() / (dims[0] - 1)),
+                      static_cast<vtkm::FloatDefault>(bounds.Y.Length() / (dims[1] - 1)),
+                      static_cast<vtkm::FloatDefault>(bounds.Z.Length() / (dims[2] - 1)));
+
+  temporal::FieldSnapshot fields;
+  fields.DataSet = vtkm::cont::DataSetBuilderUniform::Create(dims, origin, spacing);
+  fields.Time = 0;
+  vtkm::cont::Invoker invoker;
+  invoker(detail::EvaluateShape(shape, bounds, DOMAIN_SIZE / 8),
+          fields.DataSet.GetCoordinateSystem().GetDataAsMultiplexer(),
+          fields.Electric,
+          fields.Magnetic);
+  fields.DataSet.AddPointField("E", fields.Electric);
+  fields.DataSet.AddPointField("B", fields.Magnetic);
+  return fields;
+}
+
+// Species dataset of `numElectrons` electrons with the x, y, z, ux, uy,
+// uz, mass, charge and w fields of a WarpX species file.
+inline vtkm::cont::DataSet MakeBeam(vtkm::Id numElectrons, vtkm::UInt32 seed)
+{
+  vtkm::cont::ArrayHandleRandomUniformReal<vtkm::Float64> random(7 * numElectrons, { seed });
+  vtkm::cont::ArrayHandleSOA<vtkm::Vec3f> positions, momenta;
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> weighting;
+  vtkm::cont::Invoker invoker;
+  invoker(detail::MakeElectron(GetDomainBounds(), DOMAIN_SIZE / 4),
+          vtkm::cont::make_ArrayHandleGroupVec<7>(random),
+          positions,
+          momenta,
+          weighting);
+
+  // Species files are point sets, so the beam also has the positions as
+  // its coordinates.
+  vtkm::cont::DataSet beam;
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+  vtkm::cont::ArrayCopy(positions, points);
+  beam.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", points));
+  const char* names[] = { "x", "y", "z", "ux", "uy", "uz" };
+  for(vtkm::IdComponent i = 0; i < 3; i++)
+  {
+    beam.AddPointField(names[i], positions.GetArray(i));
+    beam.AddPointField(names[3 + i], momenta.GetArray(i));
+  }
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> mass, charge;
+  mass.AllocateAndFill(numElectrons, ELECTRON_MASS);
+  charge.AllocateAndFill(numElectrons, ELECTRON_CHARGE);
+  beam.AddPointField("mass", mass);
+  beam.AddPointField("charge", charge);
+  beam.AddPointField("w", weighting);
+  return beam;
+}
+
+} // namespace synthetic
+
+#endif
@@ -0,0 +1,128 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include <vtkm/CellShape.h>
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+
+#include "FilterStreamlines.h"
+
+namespace
+{
+
+// Polylines of increasing curvature : a straight line, a helix, a tight
+// zigzag, a two point line and a long helix of 12000 points.  With
+// `shuffle`, every polyline's points are stored in reverse order at the
+// end of the coordinates, so the connectivity is not 0, 1, 2...
+vtkm::cont::DataSet MakeLines(bool shuffle)
+{
+  std::vector<std::vector<vtkm::Vec3f>> lines(5);
+  for(vtkm::Id i = 0; i < 20; i++)
+    lines[0].push_back(vtkm::Vec3f(static_cast<vtkm::FloatDefault>(i), 0, 0));
+  for(vtkm::Id i = 0; i < 50; i++)
+  {
+    vtkm::FloatDefault t = static_cast<vtkm::FloatDefault>(0.3 * i);
+    lines[1].push_back(vtkm::Vec3f(vtkm::Cos(t), vtkm::Sin(t), static_cast<vtkm::FloatDefault>(0.1) * t));
+  }
+  for(vtkm::Id i = 0; i < 30; i++)
+    lines[2].push_back(vtkm::Vec3f(static_cast<vtkm::FloatDefault>(i), static_cast<vtkm::FloatDefault>(i % 2), 0));
+  lines[3] = { vtkm::Vec3f(0, 0, 0), vtkm::Vec3f(1, 1, 1) };
+  for(vtkm::Id i = 0; i < 12000; i++)
+  {
+    vtkm::FloatDefault t = static_cast<vtkm::FloatDefault>(0.01 * i);
+    lines[4].push_back(vtkm::Vec3f(vtkm::Cos(t), vtkm::Sin(t), static_cast<vtkm::FloatDefault>(0.05) * t));
+  }
+
+  std::vector<vtkm::Vec3f> points;
+  std::vector<vtkm::Id> connectivity;
+  std::vector<vtkm::Id> offsets = { 0 };
+  std::vector<vtkm::UInt8> shapes;
+  for(const auto& line : lines)
+  {
+    vtkm::Id start = static_cast<vtkm::Id>(points.size());
+    vtkm::Id count = static_cast<vtkm::Id>(line.size());
+    for(vtkm::Id i = 0; i < count; i++)
+      points.push_back(line[shuffle ? count - 1 - i : i]);
+    for(vtkm::Id i = 0; i < count; i++)
+      connectivity.push_back(shuffle ? start + count - 1 - i : start + i);
+    offsets.push_back(offsets.back() + count);
+    shapes.push_back(vtkm::CELL_SHAPE_POLY_LINE);
+  }
+
+  vtkm::cont::CellSetExplicit<> cells;
+  cells.Fill(static_cast<vtkm::Id>(points.size()),
+             vtkm::cont::make_ArrayHandle(shapes, vtkm::CopyFlag::On),
+             vtkm::cont::make_ArrayHandle(connectivity, vtkm::CopyFlag::On),
+             vtkm::cont::make_ArrayHandle(offsets, vtkm::CopyFlag::On));
+  vtkm::cont::DataSet dataset;
+  dataset.AddCoordinateSystem(
+    vtkm::cont::CoordinateSystem("coords", vtkm::cont::make_ArrayHandle(points, vtkm::CopyFlag::On)));
+  dataset.SetCellSet(cells);
+  return dataset;
+}
+
+template <typename ArrayType>
+void RequireEqualArrays(const ArrayType& expected, const ArrayType& actual)
+{
+  REQUIRE(expected.GetNumberOfValues() == actual.GetNumberOfValues());
+  auto expectedPortal = expected.ReadPortal();
+  auto actualPortal = actual.ReadPortal();
+  for(vtkm::Id i = 0; i < expected.GetNumberOfValues(); i++)
+    REQUIRE(expectedPortal.Get(i) == actualPortal.Get(i));
+}
+
+void RequireSameStreamlines(const vtkm::cont::DataSet& expected, const vtkm::cont::DataSet& actual)
+{
+  using CellSetType = vtkm::cont::CellSetExplicit<>;
+  CellSetType expectedCells = expected.GetCellSet().Cast<CellSetType>();
+  CellSetType actualCells = actual.GetCellSet().Cast<CellSetType>();
+  REQUIRE(expectedCells.GetNumberOfCells() == actualCells.GetNumberOfCells());
+  vtkm::TopologyElementTagCell visit{};
+  vtkm::TopologyElementTagPoint incident{};
+  RequireEqualArrays(expectedCells.GetOffsetsArray(visit, incident), actualCells.GetOffsetsArray(visit, incident));
+  RequireEqualArrays(expectedCells.GetConnectivityArray(visit, incident),
+                     actualCells.GetConnectivityArray(visit, incident));
+  RequireEqualArrays(expectedCells.GetShapesArray(visit, incident), actualCells.GetShapesArray(visit, incident));
+
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> expectedCoords, actualCoords;
+  expected.GetCoordinateSystem().GetData().AsArrayHandle(expectedCoords);
+  actual.GetCoordinateSystem().GetData().AsArrayHandle(actualCoords);
+  RequireEqualArrays(expectedCoords, actualCoords);
+}
+
+} // namespace
+
+TEST_CASE("Fused filter matches FilterStreamLines on streamline layout", "[filter]")
+{
+  vtkm::cont::DataSet lines = MakeLines(false);
+  REQUIRE(detail::HasStreamlineLayout(lines));
+  // Keeps every line, a curved subset and none of them.
+  for(vtkm::FloatDefault threshold : { static_cast<vtkm::FloatDefault>(-1), static_cast<vtkm::FloatDefault>(0.5),
+                                       static_cast<vtkm::FloatDefault>(1e30) })
+  {
+    statistics::CurvatureStatistics stats, fusedStats;
+    stats.Percentiles = fusedStats.Percentiles = { 50. };
+    vtkm::cont::DataSet expected = FilterStreamLines(lines, threshold, stats);
+    vtkm::cont::DataSet actual = FilterStreamLinesFused(lines, threshold, fusedStats);
+    RequireSameStreamlines(expected, actual);
+    REQUIRE(stats.Values == fusedStats.Values);
+  }
+}
+
+TEST_CASE("Fused filter falls back on other layouts", "[filter]")
+{
+  vtkm::cont::DataSet lines = MakeLines(true);
+  REQUIRE_FALSE(detail::HasStreamlineLayout(lines));
+  statistics::CurvatureStatistics stats, fusedStats;
+  stats.Percentiles = fusedStats.Percentiles = { 50. };
+  vtkm::cont::DataSet expected = FilterStreamLines(lines, static_cast<vtkm::FloatDefault>(0.5), stats);
+  vtkm::cont::DataSet actual = FilterStreamLinesFused(lines, static_cast<vtkm::FloatDefault>(0.5), fusedStats);
+  REQUIRE(expected.GetNumberOfCells() > 0);
+  RequireSameStreamlines(expected, actual);
+}
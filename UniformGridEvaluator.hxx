@@ -0,0 +1,226 @@
+#ifndef integration_uniform_grid_evaluator_hxx
+#define integration_uniform_grid_evaluator_hxx
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Math.h>
+#include <vtkm/Pair.h>
+#include <vtkm/Types.h>
+#include <vtkm/VecVariable.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleUniformPointCoordinates.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/ExecutionObjectBase.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include <vtkm/filter/flow/worklet/GridEvaluatorStatus.h>
+
+namespace integration
+{
+
+/*
+ * Execution side of BasicUniformGridEvaluator.  The cell holding a point
+ * is found by scaling with the inverse spacing, and E and B are stored
+ * side by side so each of the eight corners of the cell is a single fetch
+ * returning both fields.  Samples are converted to vtkm::FloatDefault
+ * before interpolation, whatever precision they are stored in.
+ */
+template <typename FieldPortalType>
+class ExecutionUniformGridEvaluator
+{
+public:
+  using StatusType = vtkm::worklet::flow::GridEvaluatorStatus;
+
+  VTKM_EXEC_CONT
+  ExecutionUniformGridEvaluator() = default;
+
+  VTKM_CONT
+  ExecutionUniformGridEvaluator(const vtkm::Vec3f& origin,
+                                const vtkm::Vec3f& spacing,
+                                const vtkm::Id3& dims,
+                                const FieldPortalType& fields)
+  : Origin(origin)
+  , Dims(dims)
+  , Fields(fields)
+  {
+    for(vtkm::IdComponent c = 0; c < 3; c++)
+    {
+      this->InverseSpacing[c] = dims[c] > 1 ? 1 / spacing[c] : 0;
+      this->Strides[c] = dims[c] > 1 ? (c == 0 ? 1 : c == 1 ? dims[0] : dims[0] * dims[1]) : 0;
+    }
+    vtkm::Vec3f last = origin + spacing * vtkm::Vec3f(dims - vtkm::Id3(1));
+    this->Bounds = vtkm::Bounds(origin, last);
+  }
+
+  template <typename Point>
+  VTKM_EXEC bool IsWithinSpatialBoundary(const Point& point) const
+  {
+    return this->Bounds.Contains(point);
+  }
+
+  VTKM_EXEC
+  bool IsWithinTemporalBoundary(const vtkm::FloatDefault& vtkmNotUsed(time)) const { return true; }
+
+  VTKM_EXEC
+  vtkm::Bounds GetSpatialBoundary() const { return this->Bounds; }
+
+  VTKM_EXEC_CONT
+  vtkm::FloatDefault GetTemporalBoundary(vtkm::Id direction) const
+  {
+    return direction > 0 ? vtkm::Infinity<vtkm::FloatDefault>() : vtkm::NegativeInfinity<vtkm::FloatDefault>();
+  }
+
+  template <typename Point>
+  VTKM_EXEC StatusType Evaluate(const Point& point,
+                                const vtkm::FloatDefault& vtkmNotUsed(time),
+                                vtkm::VecVariable<vtkm::Vec3f, 2>& out) const
+  {
+    return this->Evaluate(point, out);
+  }
+
+  template <typename Point>
+  VTKM_EXEC StatusType Evaluate(const Point& point, vtkm::VecVariable<vtkm::Vec3f, 2>& out) const
+  {
+    StatusType status;
+    if(!this->IsWithinSpatialBoundary(point))
+    {
+      status.SetFail();
+      status.SetSpatialBounds();
+      return status;
+    }
+
+    vtkm::Id base = 0;
+    vtkm::Vec3f weight;
+    for(vtkm::IdComponent c = 0; c < 3; c++)
+    {
+      vtkm::FloatDefault position = (point[c] - this->Origin[c]) * this->InverseSpacing[c];
+      // Points on the upper boundary belong to the last cell.
+      vtkm::Id index = vtkm::Min(static_cast<vtkm::Id>(position), vtkm::Max(this->Dims[c] - 2, vtkm::Id(0)));
+      weight[c] = position - static_cast<vtkm::FloatDefault>(index);
+      base += index * this->Strides[c];
+    }
+
+    vtkm::Vec3f electric(0, 0, 0);
+    vtkm::Vec3f magnetic(0, 0, 0);
+    for(vtkm::IdComponent corner = 0; corner < 8; corner++)
+    {
+      vtkm::FloatDefault w = 1;
+      vtkm::Id index = base;
+      for(vtkm::IdComponent c = 0; c < 3; c++)
+      {
+        bool upper = (corner >> c) & 1;
+        w *= upper ? weight[c] : 1 - weight[c];
+        index += upper ? this->Strides[c] : 0;
+      }
+      auto fields = this->Fields.Get(index);
+      electric = electric + w * vtkm::Vec3f(fields.first);
+      magnetic = magnetic + w * vtkm::Vec3f(fields.second);
+    }
+    out = vtkm::make_Vec(electric, magnetic);
+    status.SetOk();
+    return status;
+  }
+
+private:
+  vtkm::Vec3f Origin;
+  vtkm::Vec3f InverseSpacing;
+  vtkm::Id3 Dims;
+  vtkm::Id3 Strides;
+  vtkm::Bounds Bounds;
+  FieldPortalType Fields;
+};
+
+namespace detail
+{
+
+template <typename FieldValueType>
+class InterleaveFields : public vtkm::worklet::WorkletMapField
+{
+public:
+  using ControlSignature = void(FieldIn, FieldIn, FieldOut);
+  using ExecutionSignature = void(_1, _2, _3);
+
+  using VectorType = vtkm::Vec<FieldValueType, 3>;
+
+  VTKM_EXEC
+  void operator()(const vtkm::Vec3f& electric,
+                  const vtkm::Vec3f& magnetic,
+                  vtkm::Pair<VectorType, VectorType>& fields) const
+  {
+    fields = vtkm::make_Pair(VectorType(electric), VectorType(magnetic));
+  }
+};
+
+} // namespace detail
+
+/*
+ * E/B evaluator for fields sampled on the points of a uniform grid, a
+ * drop-in replacement for GridEvaluator<ElectroMagneticField<...>> in the
+ * steppers.  The two fields are interleaved once when the evaluator is
+ * built, in FieldValueType.  Storing them in Float32 halves the memory
+ * traffic of the fetches while positions, momenta and the interpolation
+ * itself stay in vtkm::FloatDefault.
+ */
+template <typename FieldValueType>
+class BasicUniformGridEvaluator : public vtkm::cont::ExecutionObjectBase
+{
+public:
+  using VectorType = vtkm::Vec<FieldValueType, 3>;
+  using FieldArrayType = vtkm::cont::ArrayHandle<vtkm::Pair<VectorType, VectorType>>;
+  using ExecutionType = ExecutionUniformGridEvaluator<typename FieldArrayType::ReadPortalType>;
+
+  VTKM_CONT
+  BasicUniformGridEvaluator() = default;
+
+  VTKM_CONT
+  BasicUniformGridEvaluator(const vtkm::cont::CoordinateSystem& coords,
+                            const vtkm::cont::ArrayHandle<vtkm::Vec3f>& electric,
+                            const vtkm::cont::ArrayHandle<vtkm::Vec3f>& magnetic)
+  {
+    this->Update(coords, electric, magnetic);
+  }
+
+  // Moves the evaluator to new fields.  The interleaved array keeps its
+  // allocation when the number of points is unchanged, so a series of
+  // snapshots on one grid refills the same buffer.
+  VTKM_CONT
+  void Update(const vtkm::cont::CoordinateSystem& coords,
+              const vtkm::cont::ArrayHandle<vtkm::Vec3f>& electric,
+              const vtkm::cont::ArrayHandle<vtkm::Vec3f>& magnetic)
+  {
+    vtkm::cont::ArrayHandleUniformPointCoordinates points;
+    coords.GetData().AsArrayHandle(points);
+    auto portal = points.ReadPortal();
+    this->Origin = portal.GetOrigin();
+    this->Spacing = portal.GetSpacing();
+    this->Dims = portal.GetRange3();
+    vtkm::cont::Invoker invoker;
+    invoker(detail::InterleaveFields<FieldValueType>{}, electric, magnetic, this->Fields);
+  }
+
+  // Whether the coordinates are those of a uniform grid.
+  VTKM_CONT
+  static bool CanEvaluate(const vtkm::cont::CoordinateSystem& coords)
+  {
+    return coords.GetData().IsType<vtkm::cont::ArrayHandleUniformPointCoordinates>();
+  }
+
+  VTKM_CONT
+  ExecutionType PrepareForExecution(vtkm::cont::DeviceAdapterId device, vtkm::cont::Token& token) const
+  {
+    return ExecutionType(this->Origin, this->Spacing, this->Dims, this->Fields.PrepareForInput(device, token));
+  }
+
+private:
+  vtkm::Vec3f Origin;
+  vtkm::Vec3f Spacing;
+  vtkm::Id3 Dims;
+  FieldArrayType Fields;
+};
+
+using UniformGridEvaluator = BasicUniformGridEvaluator<vtkm::FloatDefault>;
+using MixedUniformGridEvaluator = BasicUniformGridEvaluator<vtkm::Float32>;
+
+} // namespace integration
+
+#endif
@@ -0,0 +1,286 @@
+#include <glob.h>
+
+#include <algorithm>
+
+#include "Device.h"
+#include "ValidateOptions.hxx"
+
+namespace validate
+{
+
+std::vector<std::string> ExpandFiles(const std::string& toExpand)
+{
+  std::vector<std::string> files;
+  for(const auto& pattern : Tokenize<std::string>(toExpand))
+  {
+    glob_t matches;
+    if(glob(pattern.c_str(), 0, nullptr, &matches) == 0)
+    {
+      std::vector<std::string> expanded(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+      std::sort(expanded.begin(), expanded.end());
+      files.insert(files.end(), expanded.begin(), expanded.end());
+    }
+    globfree(&matches);
+  }
+  return files;
+}
+
+int ValidateOptions(options::variables_map& vm,
+                    config::Config& config)
+{
+  // Time series of field snapshots, with the simulation time of each.
+  if(vm.count("fields"))
+  {
+    std::vector<std::string> files = Tokenize<std::string>(vm["fields"].as<std::string>());
+    if(!vm.count("fieldtimes"))
+      return -1;
+    std::vector<vtkm::FloatDefault> times = Tokenize<vtkm::FloatDefault>(vm["fieldtimes"].as<std::string>());
+    if(files.size() < 2 || times.size() != files.size())
+      return -1;
+    for(std::size_t i = 1; i < times.size(); i++)
+    {
+      if(times[i] <= times[i - 1])
+        return -1;
+    }
+    config.SetFieldFiles(files);
+    config.SetFieldTimes(times);
+  }
+
+  // Batch runs pair every field snapshot with a species snapshot, the
+  // first pair stands in for data/seeddata.
+  if(vm.count("batchfields") || vm.count("batchseeds"))
+  {
+    if(!vm.count("batchfields") || !vm.count("batchseeds"))
+      return -1;
+    std::vector<std::string> fieldFiles = ExpandFiles(vm["batchfields"].as<std::string>());
+    std::vector<std::string> seedFiles = ExpandFiles(vm["batchseeds"].as<std::string>());
+    if(fieldFiles.empty() || fieldFiles.size() != seedFiles.size())
+      return -1;
+    config.SetBatchFiles(fieldFiles, seedFiles);
+    config.SetDataSetName(fieldFiles.front());
+    config.SetSeedData(seedFiles.front());
+  }
+  else if(config.IsTemporal())
+  {
+    // The first field snapshot provides the grid, `data` is not needed.
+    config.SetDataSetName(config.GetFieldFiles().front());
+  }
+  else
+  {
+    if(!vm.count("data"))
+      return -1;
+    config.SetDataSetName(vm["data"].as<std::string>());
+  }
+//  if(!vm.count("field"))
+//    return -1;
+//  config.SetFieldName(vm["field"].as<std::string>());
+  if(!vm.count("steps"))
+    return -1;
+  config.SetNumSteps(vm["steps"].as<vtkm::Id>());
+  if(!vm.count("length"))
+    return -1;
+  config.SetStepLength(vm["length"].as<vtkm::FloatDefault>());
+  if(!vm.count("seeds"))
+    return -1;
+  vtkm::Id numSeeds = vm["seeds"].as<vtkm::Id>();
+  config.SetNumSeeds(numSeeds);
+  if(!config.IsBatch())
+  {
+    if(!vm.count("seeddata"))
+      return -1;
+    config.SetSeedData(vm["seeddata"].as<std::string>());
+  }
+  if(!vm.count("threshold"))
+    config.SetThreshold(0.0);
+  config.SetThreshold(vm["threshold"].as<vtkm::FloatDefault>());
+
+  vtkm::Bounds bounds;
+  vtkm::Id3 sampling(0,0,0);
+  if(vm.count("sampleX"))
+  {
+    sampling[0] = 1;
+    std::vector<vtkm::FloatDefault> xextent = Tokenize<vtkm::FloatDefault>(vm["sampleX"].as<std::string>());
+    bounds.X = vtkm::Range(xextent.at(0), xextent.at(1));
+  }
+  if(vm.count("sampleY"))
+  {
+    sampling[1] = 1;
+    std::vector<vtkm::FloatDefault> yextent = Tokenize<vtkm::FloatDefault>(vm["sampleY"].as<std::string>());
+    bounds.Y = vtkm::Range(yextent.at(0), yextent.at(1));
+  }
+  if(vm.count("sampleZ"))
+  {
+    sampling[2] = 1;
+    std::vector<vtkm::FloatDefault> zextent = Tokenize<vtkm::FloatDefault>(vm["sampleZ"].as<std::string>());
+    bounds.Z = vtkm::Range(zextent.at(0), zextent.at(1));
+  }
+  config.SetBounds(bounds);
+  config.SetUserExtents(sampling);
+
+  if(vm.count("sampling"))
+  {
+    std::string option = vm["sampling"].as<std::string>();
+    if(option == "uniform")
+      config.SetSampling(config::SamplingOption::UNIFORM);
+    else if(option == "weighted")
+      config.SetSampling(config::SamplingOption::WEIGHTED);
+    else
+      return -1;
+  }
+  if(vm.count("samplingseed"))
+    config.SetSamplingSeed(vm["samplingseed"].as<vtkm::UInt32>());
+
+  if(vm.count("streamformat"))
+  {
+    std::string format = vm["streamformat"].as<std::string>();
+    if(format == "vtk")
+      config.SetStreamFormat(config::StreamFormat::VTK);
+    else if(format == "raw")
+      config.SetStreamFormat(config::StreamFormat::RAW);
+    else
+      return -1;
+  }
+
+  if(vm.count("integrator"))
+  {
+    std::string integrator = vm["integrator"].as<std::string>();
+    if(integrator == "rk4")
+      config.SetIntegrator(config::IntegratorOption::RK4);
+    else if(integrator == "boris")
+      config.SetIntegrator(config::IntegratorOption::BORIS);
+    else if(integrator == "compare")
+      config.SetIntegrator(config::IntegratorOption::COMPARE);
+    else
+      return -1;
+  }
+  if(vm.count("cflfactor"))
+  {
+    vtkm::FloatDefault cflFactor = vm["cflfactor"].as<vtkm::FloatDefault>();
+    if(!(cflFactor > 0))
+      return -1;
+    config.SetCflFactor(cflFactor);
+  }
+  if(vm.count("evalbenchmark"))
+    config.SetEvaluatorBenchmark(vm["evalbenchmark"].as<vtkm::Id>());
+
+  if(vm.count("precision"))
+  {
+    std::string precision = vm["precision"].as<std::string>();
+    if(precision == "double")
+      config.SetPrecision(config::PrecisionOption::DOUBLE);
+    else if(precision == "mixed")
+      config.SetPrecision(config::PrecisionOption::MIXED);
+    else if(precision == "compare")
+      config.SetPrecision(config::PrecisionOption::COMPARE);
+    else
+      return -1;
+  }
+  // Batch runs only advect with RK4, once per iteration.
+  if(config.IsBatch() && (config.GetIntegratorOption() != config::IntegratorOption::RK4 ||
+                          config.GetPrecisionOption() == config::PrecisionOption::COMPARE))
+    return -1;
+  if(vm.count("reorder"))
+  {
+    vtkm::Id interval = vm["reorder"].as<vtkm::Id>();
+    if(interval < 0)
+      return -1;
+    config.SetReorderInterval(interval);
+  }
+  if(vm.count("chunksteps"))
+  {
+    vtkm::Id chunkSteps = vm["chunksteps"].as<vtkm::Id>();
+    if(chunkSteps < 0)
+      return -1;
+    config.SetChunkSteps(chunkSteps);
+  }
+  if(vm.count("workers"))
+  {
+    vtkm::Id workers = vm["workers"].as<vtkm::Id>();
+    if(workers < 0)
+      return -1;
+    config.SetWorkers(workers);
+  }
+  if(vm.count("trace"))
+    config.SetTraceFile(vm["trace"].as<std::string>());
+  if(vm.count("verbose"))
+    config.SetVerbose(vm["verbose"].as<bool>());
+  if(vm.count("device"))
+  {
+    std::string name = vm["device"].as<std::string>();
+    vtkm::cont::DeviceAdapterId device;
+    if(!device::ParseDevice(name, device))
+      return -1;
+    config.SetDevice(name);
+  }
+  if(vm.count("threads"))
+  {
+    vtkm::Id threads = vm["threads"].as<vtkm::Id>();
+    if(threads < 0)
+      return -1;
+    config.SetThreads(threads);
+  }
+  if(vm.count("scaling"))
+  {
+    vtkm::Id scalingThreads = vm["scaling"].as<vtkm::Id>();
+    if(scalingThreads < 0)
+      return -1;
+    config.SetScalingThreads(scalingThreads);
+  }
+
+/*  config::SeedingOption seeding  = static_cast<config::SeedingOption>(vm["seeding"].as<int>());
+  config.SetSeeding(seeding);
+  // Get seeding rake
+  // If not provided / use dataset extents.
+  vtkm::Bounds bounds;
+  vtkm::Id3 userExtents(0,0,0);
+  if(vm.count("xextent"))
+  {
+    userExtents[0] = 1;
+    std::vector<vtkm::FloatDefault> xextent = Tokenize<vtkm::FloatDefault>(vm["xextent"].as<std::string>());
+    bounds.X = vtkm::Range(xextent.at(0), xextent.at(1));
+  }
+  if(vm.count("yextent"))
+  {
+    userExtents[1] = 1;
+    std::vector<vtkm::FloatDefault> yextent = Tokenize<vtkm::FloatDefault>(vm["yextent"].as<std::string>());
+    bounds.Y = vtkm::Range(yextent.at(0), yextent.at(1));
+  }
+  if(vm.count("zextent"))
+  {
+    userExtents[2] = 1;
+    std::vector<vtkm::FloatDefault> zextent = Tokenize<vtkm::FloatDefault>(vm["zextent"].as<std::string>());
+    bounds.Z = vtkm::Range(zextent.at(0), zextent.at(1));
+  }
+  config.SetBounds(bounds);
+  config.SetUserExtents(userExtents);
+  if(seeding == config::SeedingOption::UNIFORM)
+  {
+    if(!vm.count("dims"))
+      return -1;
+    std::vector<vtkm::Id> _dims = Tokenize<vtkm::Id>(vm["dims"].as<std::string>());
+    vtkm::Id3 dims(_dims.at(0), _dims.at(1), _dims.at(2));
+    config.SetDimensions(dims);
+  }
+  else if(seeding == config::SeedingOption::RANDOM)
+  {
+    if(!vm.count("seeds"))
+      return -1;
+    vtkm::Id numSeeds = vm["seeds"].as<vtkm::Id>();
+    config.SetNumSeeds(numSeeds);
+  }
+  else if(seeding == config::SeedingOption::SINGLE)
+  {
+    if(!vm.count("seeds"))
+      return -1;
+    if(!vm.count("point"))
+      return -1;
+    vtkm::Id numSeeds = vm["seeds"].as<vtkm::Id>();
+    config.SetNumSeeds(numSeeds);
+    std::vector<vtkm::FloatDefault> _point = Tokenize<vtkm::FloatDefault>(vm["point"].as<std::string>());
+    vtkm::Vec3f point(_point.at(0), _point.at(1), _point.at(2));
+    config.SetPoint(point);
+  }*/
+  return 0;
+}
+
+} // namespace validate
@@ -2,90 +2,439 @@
 
 #include <iostream>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "boost/program_options.hpp"
 
+#include <vtkm/BinaryOperators.h>
 #include <vtkm/Types.h>
 #include <vtkm/cont/Algorithm.h>
 #include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandleGroupVec.h>
 #include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/ArrayHandleRandomUniformReal.h>
 #include <vtkm/cont/Timer.h>
 
 #include <vtkm/io/VTKDataSetReader.h>
-#include <vtkm/io/VTKDataSetWriter.h>
 
 #include <vtkm/worklet/WorkletMapField.h>
 
 #include <vtkm/filter/flow/worklet/ParticleAdvection.h>
 #include <vtkm/filter/flow/worklet/Field.h>
 #include <vtkm/filter/flow/worklet/GridEvaluators.h>
+#include <vtkm/filter/flow/worklet/TemporalGridEvaluators.h>
 #include <vtkm/filter/flow/worklet/EulerIntegrator.h>
 #include <vtkm/filter/flow/worklet/RK4Integrator.h>
 #include <vtkm/filter/flow/worklet/Stepper.h>
 #include <vtkm/filter/flow/worklet/ParticleAdvectionWorklets.h>
 
+#include "AdvectionScheduler.hxx"
+#include "BorisStepper.hxx"
+#include "ChunkedHistory.hxx"
 #include "Config.h"
+#include "Device.h"
+#include "FieldEvaluators.hxx"
+#include "FieldSeries.hxx"
+#include "HybridScheduler.hxx"
+#include "Instrumentation.h"
+#include "ParticleSnapshot.hxx"
 #include "SeedGenerator.hxx"
+#include "SeedSampling.hxx"
+#include "StreamlineWriter.hxx"
+#include "UniformGridEvaluator.hxx"
 #include "ValidateOptions.hxx"
 
 namespace detail
 {
-class GetSteps : public vtkm::worklet::WorkletMapField
+class SetTime : public vtkm::worklet::WorkletMapField
 {
 public:
   VTKM_CONT
-  GetSteps() {}
+  SetTime(vtkm::FloatDefault time)
+  : Time(time)
+  {}
+  using ControlSignature = void(FieldInOut);
+  using ExecutionSignature = void(_1);
+  VTKM_EXEC void operator()(vtkm::ChargedParticle& p) const
+  {
+    p.Time = this->Time;
+  }
+
+private:
+  vtkm::FloatDefault Time;
+};
+
+// Particles that stopped at the end of a field interval carry on into the
+// next one.  Particles that left the domain or terminated stay stopped.
+class ResumeParticles : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  ResumeParticles() {}
+  using ControlSignature = void(FieldInOut);
+  using ExecutionSignature = void(_1);
+  VTKM_EXEC void operator()(vtkm::ChargedParticle& p) const
+  {
+    if(p.Status.CheckTemporalBounds() && !p.Status.CheckSpatialBounds() && !p.Status.CheckTerminate())
+    {
+      p.Status.ClearTemporalBounds();
+      p.Status.SetOk();
+    }
+  }
+};
+
+void PrintCacheMisses(vtkm::Int64 misses)
+{
+  if(misses < 0)
+    std::cout << "Cache misses : unavailable (no perf events)" << std::endl;
+  else
+    std::cout << "Cache misses : " << misses << std::endl;
+}
+
+// Advects the particles, in chunks of `chunksteps` steps and sorted along
+// a Morton curve of `bounds` when the options ask for it.
+template <typename ParticleType, typename StepperType>
+void Advect(const config::Config& config,
+            const vtkm::Bounds& bounds,
+            ParticleType& particles,
+            const StepperType& stepper)
+{
+  instrumentation::Scope scope("Advection");
+  scope.SetCount(particles.GetParticles().GetNumberOfValues());
+  // Cache misses of the advection, sorts included, are only counted with
+  // `reorder`, or with `verbose` for the unsorted run to compare against.
+  bool countMisses = config.IsReordered() || config.IsVerbose();
+  instrumentation::CacheMissCounter counter;
+  if(countMisses)
+    counter.Start();
+  if(!config.IsReordered() && config.GetChunkSteps() == 0)
+  {
+    particles.Advect(stepper);
+    if(countMisses)
+      detail::PrintCacheMisses(counter.Stop());
+    return;
+  }
+  scheduling::ChunkedAdvection scheduler(bounds, config.GetChunkSteps(), config.GetReorderInterval());
+  scheduler.Advect(particles, stepper);
+  if(countMisses)
+    detail::PrintCacheMisses(counter.Stop());
+  vtkm::Id numParticles = particles.GetParticles().GetNumberOfValues();
+  for(const auto& chunk : scheduler.GetReports())
+  {
+    std::cout << "Chunk " << chunk.FirstStep << " : " << chunk.NumberOfActive << " / " << numParticles
+              << " active, " << chunk.Time << std::endl;
+  }
+  const auto& order = scheduler.GetOrder();
+  if(config.IsReordered())
+  {
+    std::cout << "Reorder : " << order.GetSortTime() << " (" << order.GetNumberOfSorts() << " sorts)" << std::endl;
+    std::cout << "Neighbour distance : " << order.GetInputDistance() << " (input), "
+              << order.GetSortedDistance() << " (sorted)" << std::endl;
+  }
+}
+
+class ScaleToBounds : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  ScaleToBounds(const vtkm::Bounds& bounds)
+  : Origin(vtkm::Vec3f(bounds.MinCorner()))
+  , Size(bounds.X.Length(), bounds.Y.Length(), bounds.Z.Length())
+  {}
   using ControlSignature = void(FieldIn, FieldOut);
   using ExecutionSignature = void(_1, _2);
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& p, vtkm::Id& numSteps) const
+  VTKM_EXEC void operator()(const vtkm::Vec<vtkm::Float64, 3>& uniform, vtkm::Vec3f& point) const
   {
-    numSteps = p.NumSteps;
+    point = this->Origin + this->Size * vtkm::Vec3f(uniform);
   }
+
+private:
+  vtkm::Vec3f Origin;
+  vtkm::Vec3f Size;
 };
 
-class ComputeNumPoints : public vtkm::worklet::WorkletMapField
+class EvaluateFields : public vtkm::worklet::WorkletMapField
 {
 public:
   VTKM_CONT
-  ComputeNumPoints() {}
+  EvaluateFields() {}
+  using ControlSignature = void(FieldIn, ExecObject, FieldOut, FieldOut);
+  using ExecutionSignature = void(_1, _2, _3, _4);
+  template <typename EvaluatorType>
+  VTKM_EXEC void operator()(const vtkm::Vec3f& point,
+                            const EvaluatorType& evaluator,
+                            vtkm::Vec3f& electric,
+                            vtkm::Vec3f& magnetic) const
+  {
+    vtkm::VecVariable<vtkm::Vec3f, 2> values;
+    bool ok = evaluator.Evaluate(point, 0, values).CheckOk();
+    electric = ok ? values[0] : vtkm::Vec3f(0, 0, 0);
+    magnetic = ok ? values[1] : vtkm::Vec3f(0, 0, 0);
+  }
+};
+
+class FieldDifference : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  FieldDifference() {}
   using ControlSignature = void(FieldIn, FieldIn, FieldOut);
   using ExecutionSignature = void(_1, _2, _3);
+  VTKM_EXEC void operator()(const vtkm::Vec3f& a, const vtkm::Vec3f& b, vtkm::FloatDefault& diff) const
+  {
+    diff = vtkm::Magnitude(a - b) / vtkm::Max(vtkm::Magnitude(a), vtkm::Epsilon<vtkm::FloatDefault>());
+  }
+};
+
+// Largest relative difference of E and B from the reference evaluation.
+void PrintFieldDifference(const std::string& label,
+                          const vtkm::cont::ArrayHandle<vtkm::Vec3f>& electric,
+                          const vtkm::cont::ArrayHandle<vtkm::Vec3f>& magnetic,
+                          const vtkm::cont::ArrayHandle<vtkm::Vec3f>& otherElectric,
+                          const vtkm::cont::ArrayHandle<vtkm::Vec3f>& otherMagnetic)
+{
+  vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> diff;
+  invoker(FieldDifference{}, electric, otherElectric, diff);
+  vtkm::FloatDefault maxElectric = vtkm::cont::Algorithm::Reduce(diff, vtkm::FloatDefault(0), vtkm::Maximum());
+  invoker(FieldDifference{}, magnetic, otherMagnetic, diff);
+  vtkm::FloatDefault maxMagnetic = vtkm::cont::Algorithm::Reduce(diff, vtkm::FloatDefault(0), vtkm::Maximum());
+  std::cout << "Evaluator difference (" << label << ", max relative) : E " << maxElectric
+            << ", B " << maxMagnetic << std::endl;
+}
+
+// Seconds taken by one pass of evaluations at `points`, after a warm-up pass.
+template <typename EvaluatorType>
+vtkm::Float64 TimeEvaluations(const EvaluatorType& evaluator,
+                              const vtkm::cont::ArrayHandle<vtkm::Vec3f>& points,
+                              vtkm::cont::ArrayHandle<vtkm::Vec3f>& electric,
+                              vtkm::cont::ArrayHandle<vtkm::Vec3f>& magnetic)
+{
+  vtkm::cont::Invoker invoker;
+  invoker(EvaluateFields{}, points, evaluator, electric, magnetic);
+  vtkm::cont::Timer timer;
+  timer.Start();
+  invoker(EvaluateFields{}, points, evaluator, electric, magnetic);
+  timer.Stop();
+  return timer.GetElapsedTime();
+}
+
+// Evaluations/sec of the generic and uniform evaluators, the latter with
+// double and Float32 fields, at random points of the domain, and the
+// largest relative difference of each from the generic one.
+void BenchmarkEvaluators(const temporal::FieldSnapshot& fields, vtkm::Id numSamples)
+{
+  const vtkm::cont::CoordinateSystem& coords = fields.DataSet.GetCoordinateSystem();
+  vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandleRandomUniformReal<vtkm::Float64> uniform(3 * numSamples, { 314 });
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+  invoker(ScaleToBounds(coords.GetBounds()), vtkm::cont::make_ArrayHandleGroupVec<3>(uniform), points);
+
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> electric, magnetic;
+  integration::GenericEvaluatorType generic(coords, fields.DataSet.GetCellSet(),
+                                            integration::FieldType(fields.Electric, fields.Magnetic));
+  vtkm::Float64 genericTime = TimeEvaluations(generic, points, electric, magnetic);
+  std::cout << "Evaluations (generic) : " << numSamples / genericTime << " evals/sec" << std::endl;
+  if(!integration::UniformGridEvaluator::CanEvaluate(coords))
+    return;
+
+  vtkm::cont::Timer timer;
+  timer.Start();
+  integration::UniformGridEvaluator interleaved(coords, fields.Electric, fields.Magnetic);
+  timer.Stop();
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> uniformElectric, uniformMagnetic;
+  vtkm::Float64 uniformTime = TimeEvaluations(interleaved, points, uniformElectric, uniformMagnetic);
+  std::cout << "Evaluations (uniform) : " << numSamples / uniformTime << " evals/sec ("
+            << genericTime / uniformTime << "x, interleave " << timer.GetElapsedTime() << ")" << std::endl;
+
+  PrintFieldDifference("uniform", electric, magnetic, uniformElectric, uniformMagnetic);
+
+  integration::MixedUniformGridEvaluator mixed(coords, fields.Electric, fields.Magnetic);
+  vtkm::Float64 mixedTime = TimeEvaluations(mixed, points, uniformElectric, uniformMagnetic);
+  std::cout << "Evaluations (uniform, Float32 fields) : " << numSamples / mixedTime << " evals/sec ("
+            << genericTime / mixedTime << "x)" << std::endl;
+  PrintFieldDifference("uniform, Float32 fields", electric, magnetic, uniformElectric, uniformMagnetic);
+}
 
-  // Offset is number of points in streamline.
-  // 1 (inital point) + number of steps taken (p.NumSteps - initalNumSteps)
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& p,
-                            const vtkm::Id& initialNumSteps,
-                            vtkm::Id& diff) const
+class PositionDeviation : public vtkm::worklet::WorkletMapField
+{
+public:
+  VTKM_CONT
+  PositionDeviation() {}
+  using ControlSignature = void(FieldIn, FieldIn, FieldOut, FieldOut);
+  using ExecutionSignature = void(_1, _2, _3, _4);
+
+  // Only particles that both runs followed up to the last step are
+  // compared, the others did not end at the same time.
+  VTKM_EXEC void operator()(const vtkm::ChargedParticle& reference,
+                            const vtkm::ChargedParticle& p,
+                            vtkm::FloatDefault& squared,
+                            vtkm::Id& compared) const
   {
-      diff = 1 + p.NumSteps - initialNumSteps;
+    bool complete = reference.Status.CheckTerminate() && !reference.Status.CheckSpatialBounds() &&
+                    p.Status.CheckTerminate() && !p.Status.CheckSpatialBounds();
+    compared = complete ? 1 : 0;
+    squared = complete ? vtkm::MagnitudeSquared(p.Pos - reference.Pos) : 0;
   }
 };
 
-} // namespace detail
+// Prints the RMS distance between the final positions of two runs, in
+// meters and in cells of the given size.
+void PrintDeviation(const std::string& label,
+                    const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& reference,
+                    const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& particles,
+                    vtkm::FloatDefault cellSize)
+{
+  vtkm::cont::Invoker invoker;
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> squared;
+  vtkm::cont::ArrayHandle<vtkm::Id> compared;
+  invoker(PositionDeviation{}, reference, particles, squared, compared);
+  vtkm::Id count = vtkm::cont::Algorithm::Reduce(compared, static_cast<vtkm::Id>(0));
+  vtkm::FloatDefault sum = vtkm::cont::Algorithm::Reduce(squared, static_cast<vtkm::FloatDefault>(0));
+  vtkm::FloatDefault rms = count > 0 ? vtkm::Sqrt(sum / count) : 0;
+  std::cout << label << " (RMS) : " << rms << " (" << rms / cellSize << " cells, "
+            << count << " particles)" << std::endl;
+}
+
+// Per-worker advection times of one scheduler run, and their imbalance.
+template <typename SchedulerType>
+void PrintWorkerTimes(const std::string& label, const SchedulerType& scheduler, vtkm::Float64 wall)
+{
+  const std::vector<vtkm::Float64>& times = scheduler.GetWorkerTimes();
+  vtkm::Float64 sum = 0, max = 0;
+  std::cout << "Workers (" << label << ") :";
+  for(vtkm::Float64 time : times)
+  {
+    std::cout << " " << time;
+    sum += time;
+    max = vtkm::Max(max, time);
+  }
+  std::cout << std::endl;
+  vtkm::Float64 mean = sum / static_cast<vtkm::Float64>(times.size());
+  std::cout << "Imbalance (" << label << ") : " << (mean > 0 ? max / mean : 1) << ", "
+            << scheduler.GetNumberOfReplicas() << " block replicas, "
+            << scheduler.GetNumberOfRounds() << " rounds" << std::endl;
+  std::cout << "Throughput (" << label << ") : " << scheduler.GetNumberOfSteps() / wall << " steps/sec ("
+            << wall << ")" << std::endl;
+}
 
-void GenerateRandomIndices(std::vector<vtkm::Id>& randoms, vtkm::Id numberOfSeeds, vtkm::Id total)
+/*
+ * Advects the seeds on `workers` threads over z blocks of the grid, first
+ * with one worker per block, then with the blocks holding more than a
+ * fair share of the seeds replicated over several workers.  A clustered
+ * beam leaves most workers idle in the first run.
+ */
+template <typename EvaluatorType>
+void BenchmarkSchedulers(const config::Config& config,
+                         const temporal::FieldSnapshot& fields,
+                         const EvaluatorType& evaluator,
+                         const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& seeds,
+                         vtkm::FloatDefault length)
 {
-  srand(314);
-  for (int index = 0; index < numberOfSeeds; index++)
+  vtkm::Id numWorkers = config.GetWorkers();
+  vtkm::Id3 dims = distributed::detail::GetPointDimensions(fields.DataSet);
+  std::vector<distributed::Slab> blocks =
+    distributed::DecomposeSlabs(fields.DataSet, vtkm::Min(4 * numWorkers, dims[2] - 1));
+  scheduling::HybridScheduler<EvaluatorType> scheduler(evaluator,
+                                                       fields.DataSet.GetCoordinateSystem().GetBounds(),
+                                                       blocks,
+                                                       numWorkers,
+                                                       length,
+                                                       config.GetNumSteps());
+  for(bool replicateHot : { false, true })
   {
-    randoms.push_back(rand() % total);
+    vtkm::cont::Timer timer;
+    timer.Start();
+    scheduler.Advect(seeds, replicateHot);
+    timer.Stop();
+    PrintWorkerTimes(replicateHot ? "hybrid" : "blocks", scheduler, timer.GetElapsedTime());
   }
 }
 
+/*
+ * Reruns the RK4 advection of the seeds on the current device with 1, 2,
+ * 4, ... and `scaling` threads.  Speedup and parallel efficiency are
+ * relative to the single thread run.
+ */
+template <typename EvaluatorType>
+void BenchmarkScaling(const config::Config& config,
+                      const vtkm::Bounds& bounds,
+                      const EvaluatorType& evaluator,
+                      const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& seeds,
+                      vtkm::FloatDefault length)
+{
+  vtkm::Id maxThreads = config.GetScalingThreads();
+  std::vector<vtkm::Id> counts;
+  for(vtkm::Id threads = 1; threads < maxThreads; threads *= 2)
+    counts.push_back(threads);
+  counts.push_back(maxThreads);
+
+  vtkm::Id initialThreads = device::GetThreads(device::GetDevice());
+  integration::RK4Stepper<EvaluatorType> stepper(evaluator, length);
+  vtkm::Float64 serialTime = 0;
+  for(vtkm::Id threads : counts)
+  {
+    if(!device::SetThreads(threads))
+      break;
+    vtkm::cont::ArrayHandle<vtkm::ChargedParticle> particles;
+    vtkm::cont::ArrayCopy(seeds, particles);
+    history::ChunkedStateRecordingParticles<vtkm::ChargedParticle> recorded(particles, config.GetNumSteps());
+
+    vtkm::cont::Timer timer;
+    timer.Start();
+    Advect(config, bounds, recorded, stepper);
+    timer.Stop();
+
+    vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+    vtkm::Id taken = history::CountSteps(recorded, numPoints);
+    vtkm::Float64 elapsed = timer.GetElapsedTime();
+    if(threads == 1)
+      serialTime = elapsed;
+    std::cout << "Scaling (" << threads << " threads) : " << elapsed << ", " << taken / elapsed
+              << " steps/sec, speedup " << serialTime / elapsed << ", efficiency "
+              << serialTime / (threads * elapsed) << std::endl;
+  }
+  if(initialThreads > 0)
+    device::SetThreads(initialThreads);
+}
+
+} // namespace detail
+
 int main(int argc, char **argv) {
   vtkm::cont::SetStderrLogLevel(vtkm::cont::LogLevel::Off);
+  device::SelectBuildDevice();
 
   namespace options = boost::program_options;
   options::options_description desc("Options");
-  desc.add_options()("data",    options::value<std::string>()->required(),        "Path to dataset")
+  desc.add_options()("data",    options::value<std::string>(),                    "Path to dataset")
                     ("steps",   options::value<vtkm::Id>()->required(),           "Number of Steps")
                     ("length",  options::value<vtkm::FloatDefault>()->required(), "Length of a single step")
                     ("seeds",   options::value<vtkm::Id>(),        "Number of seeds for random/single seeding")
-                    ("seeddata",  options::value<std::string>()->required(), "VTK file to read electrons from")
+                    ("seeddata",  options::value<std::string>(), "VTK file to read electrons from")
                     ("threshold", options::value<vtkm::FloatDefault>()->required(), "Foltering threshold")
                     ("sampleX",  options::value<std::string>(), "Seed sampling range X")
                     ("sampleY",  options::value<std::string>(), "Seed sampling range Y")
-                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z");
+                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z")
+                    ("sampling", options::value<std::string>(), "Seed subsampling : uniform or weighted")
+                    ("samplingseed", options::value<vtkm::UInt32>(), "Random seed for seed subsampling")
+                    ("fields", options::value<std::string>(), "Field snapshots for time-varying advection, ':' separated")
+                    ("fieldtimes", options::value<std::string>(), "Simulation time of every field snapshot, ':' separated")
+                    ("batchfields", options::value<std::string>(), "Field files or glob patterns for a batch run, ':' separated")
+                    ("batchseeds", options::value<std::string>(), "Species files or glob patterns matching batchfields, ':' separated")
+                    ("streamformat", options::value<std::string>(), "Streamline output : vtk (default) or raw")
+                    ("integrator", options::value<std::string>(), "rk4 (default), boris, or compare to run both")
+                    ("cflfactor", options::value<vtkm::FloatDefault>(), "Boris substep limit, in gyration radians and grid cells")
+                    ("evalbenchmark", options::value<vtkm::Id>(), "Number of random field evaluations to time per evaluator")
+                    ("precision", options::value<std::string>(), "Field storage : double (default), mixed, or compare to run both")
+                    ("reorder", options::value<vtkm::Id>(), "Sort particles by cell before advection, and every n steps if n > 0")
+                    ("chunksteps", options::value<vtkm::Id>(), "Advect n steps at a time, dropping stopped particles between chunks")
+                    ("workers", options::value<vtkm::Id>(), "Threads of the block scheduler benchmark, 0 to skip it")
+                    ("trace", options::value<std::string>(), "Chrome trace of the stages, with a summary table at exit")
+                    ("device", options::value<std::string>(), "Device to run on : serial, openmp, tbb, ... or any")
+                    ("threads", options::value<vtkm::Id>(), "Threads of the device, 0 for the backend default")
+                    ("scaling", options::value<vtkm::Id>(), "Rerun the advection on 1 up to n threads, 0 to skip it")
+                    ("verbose", options::value<bool>(), "Print the diagnostics of the evaluators, the filter and the I/O");
 
   options::variables_map vm;
   std::ifstream settings_file(std::string(argv[1]), std::ifstream::in);
@@ -100,11 +449,14 @@ int main(int argc, char **argv) {
     std::cout << "Advection Benchmark" << std::endl << desc << std::endl;
     exit(EXIT_FAILURE);
   }
+  if(!device::SelectDevice(config.GetDevice(), config.GetThreads()))
+    exit(EXIT_FAILURE);
+  instrumentation::SetVerbose(config.IsVerbose());
+  instrumentation::Session session(config.GetTraceFile());
 
   std::string data = config.GetDataSetName();
   vtkm::Id steps = config.GetNumSteps();
   vtkm::FloatDefault length = config.GetStepLength();
-  vtkm::Id numSeeds = config.GetNumSeeds();
   std::string seeddata = config.GetSeedData();
   vtkm::FloatDefault threshold = config.GetThreshold();
 
@@ -112,116 +464,277 @@ int main(int argc, char **argv) {
   using FieldType = vtkm::worklet::flow::ElectroMagneticField<ArrayType>;
   using IndexType = vtkm::cont::ArrayHandle<vtkm::Id>;
   using SeedsType = vtkm::cont::ArrayHandle<vtkm::ChargedParticle>;
-  using EvaluatorType = vtkm::worklet::flow::GridEvaluator<FieldType>;
-  using IntegratorType = vtkm::worklet::flow::RK4Integrator<EvaluatorType>;
-  using Stepper = vtkm::worklet::flow::Stepper<IntegratorType, EvaluatorType>;
-  using ParticleType = vtkm::worklet::flow::StateRecordingParticles<vtkm::ChargedParticle>;
-  using AdvectionWorklet = vtkm::worklet::flow::ParticleAdvectWorklet;
-
-  vtkm::io::VTKDataSetReader dataReader(data);
-  vtkm::cont::DataSet dataset = dataReader.ReadDataSet();
-  vtkm::cont::DynamicCellSet cells = dataset.GetCellSet();
-  vtkm::cont::CoordinateSystem coords = dataset.GetCoordinateSystem();
-
-  auto bounds = coords.GetBounds();
-  std::cout << "Bounds : " << bounds << std::endl;
-  using Structured3DType = vtkm::cont::CellSetStructured<3>;
-  Structured3DType castedCells = cells.Cast<Structured3DType>();
-  auto dims = castedCells.GetSchedulingRange(vtkm::TopologyElementTagPoint());
-  vtkm::Vec3f spacing = {bounds.X.Length() / (dims[0] - 1),
-                         bounds.Y.Length() / (dims[1] - 1),
-                         bounds.Z.Length() / (dims[2] - 1)};
-  std::cout << spacing << std::endl;
-  constexpr static vtkm::FloatDefault SPEED_OF_LIGHT =
-    static_cast<vtkm::FloatDefault>(2.99792458e8);
-  spacing = spacing * spacing;
-  length = 1.0 / (SPEED_OF_LIGHT * vtkm::Sqrt(1./spacing[0] + 1./spacing[1] + 1./spacing[2]));
-  std::cout << "CFL length : " << length << std::endl;
+  using TemporalEvaluatorType = vtkm::worklet::flow::TemporalGridEvaluator<FieldType>;
+  using TemporalIntegratorType = vtkm::worklet::flow::RK4Integrator<TemporalEvaluatorType>;
+  using TemporalStepper = vtkm::worklet::flow::Stepper<TemporalIntegratorType, TemporalEvaluatorType>;
+  using ParticleType = history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>;
 
-  vtkm::cont::Timer timer;
-  timer.Start();
+  vtkm::cont::Invoker invoker;
 
-  ArrayType electric, magnetic;
-  dataset.GetField("E").GetData().AsArrayHandle(electric);
-  dataset.GetField("B").GetData().AsArrayHandle(magnetic);
-  FieldType electromagnetic(electric, magnetic);
+  /*
+   * Batch run : every field/species pair is advected in this process.  The
+   * next field file is read while the current pair is advected, and the
+   * seed, step and point arrays and the evaluator are reused from one
+   * iteration to the next.  Batch runs use RK4 in double or mixed
+   * precision, ValidateOptions rejects the other integrator and
+   * precision options.
+   */
+  if(config.IsBatch())
+  {
+    const auto& fieldFiles = config.GetBatchFieldFiles();
+    const auto& seedFiles = config.GetBatchSeedFiles();
+    temporal::AsyncFieldLoader batchLoader(2);
+    batchLoader.Request(fieldFiles[0], 0);
+
+    SeedsType seeds;
+    IndexType numPoints;
+    integration::CachedEvaluator evaluators;
+    bool mixed = config.GetPrecisionOption() == config::PrecisionOption::MIXED;
+    vtkm::Id totalSteps = 0;
+    vtkm::Float64 totalAdvection = 0;
+    vtkm::cont::Timer batchTimer;
+    batchTimer.Start();
+    for(std::size_t iteration = 0; iteration < fieldFiles.size(); iteration++)
+    {
+      std::cout << "Iteration " << iteration << " : " << fieldFiles[iteration]
+                << " / " << seedFiles[iteration] << std::endl;
+      instrumentation::Scope iterationScope("Iteration");
+      seeding::LoadSeeds(config, seedFiles[iteration], seeds);
+      iterationScope.SetCount(seeds.GetNumberOfValues());
+      std::size_t slot = batchLoader.Acquire();
+      if(iteration + 1 < fieldFiles.size())
+        batchLoader.Request(fieldFiles[iteration + 1], 0);
+      const temporal::FieldSnapshot& fields = batchLoader.Get(slot);
+
+      vtkm::FloatDefault stepLength = integration::ComputeStepLength(fields.DataSet);
+      ParticleType particles(seeds, steps);
+
+      vtkm::cont::Timer timer;
+      evaluators.Dispatch(fields, mixed, [&](const auto& evaluator) {
+        using EvaluatorType = typename std::decay<decltype(evaluator)>::type;
+        integration::RK4Stepper<EvaluatorType> stepper(evaluator, stepLength);
+        timer.Start();
+        detail::Advect(config, fields.DataSet.GetCoordinateSystem().GetBounds(), particles, stepper);
+        timer.Stop();
+      });
+
+      vtkm::Id taken = history::CountSteps(particles, numPoints);
+      vtkm::Float64 elapsed = timer.GetElapsedTime();
+      totalSteps += taken;
+      totalAdvection += elapsed;
+      std::cout << "Advection : " << elapsed << std::endl;
+      std::cout << "Throughput : " << taken / elapsed << " steps/sec ("
+                << seeds.GetNumberOfValues() << " particles, " << taken << " steps)" << std::endl;
+
+      streams::WriteStreamlines(particles, "streams_" + std::to_string(iteration), config.GetStreamFormat());
+      batchLoader.Release(slot);
+    }
+    batchTimer.Stop();
+    std::cout << "Batch : " << fieldFiles.size() << " iterations in "
+              << batchTimer.GetElapsedTime() << std::endl;
+    std::cout << "Batch throughput : " << totalSteps / totalAdvection << " steps/sec (advection), "
+              << fieldFiles.size() / batchTimer.GetElapsedTime() << " iterations/sec (overall)" << std::endl;
+    temporal::PrintOverlap(batchLoader);
+    return 1;
+  }
 
-  EvaluatorType evaluator(coords, cells, electromagnetic);
-  Stepper stepper(evaluator, length);
+  vtkm::cont::Timer timer;
 
   /*
-   * Make seeds based on the seeding option.
+   * Time-varying fields : E and B are interpolated in time between the
+   * two snapshots bounding the current interval, while the next snapshot
+   * is read in the background.  Every interval writes its own streams.
    */
-  SeedsType seeds;
-
+  if(config.IsTemporal())
   {
-    SeedsType allSeeds;
-    vtkm::io::VTKDataSetReader seedsReader(seeddata);
-    vtkm::cont::DataSet seedsData = seedsReader.ReadDataSet();
-    vtkm::cont::ArrayHandle<vtkm::Id> filter;
-    seeding::GenerateChargedParticles(config, seedsData, allSeeds, filter);
-    SeedsType _allSeeds;
-    vtkm::cont::Algorithm::CopyIf(allSeeds, filter, _allSeeds);
+    timer.Start();
+    // The window blocks on the first two snapshots, the seeds are built while
+    // the third one is read.
+    temporal::FieldWindow window(config.GetFieldFiles(), config.GetFieldTimes());
+    SeedsType seeds;
+    seeding::LoadSeeds(config, seeddata, seeds);
+    // The CFL step length comes from the grid of the first snapshot.
+    length = integration::ComputeStepLength(window.GetFirst().DataSet);
+    std::cout << "Advecting " << seeds.GetNumberOfValues() << " particles" << std::endl;
+    invoker(detail::SetTime{window.GetFirst().Time}, seeds);
+
+    timer.Stop();
+    std::cout << "Pre-requisite : " << timer.GetElapsedTime() << std::endl;
+    timer.Reset();
+
+    do
+    {
+      const temporal::FieldSnapshot& first = window.GetFirst();
+      const temporal::FieldSnapshot& second = window.GetSecond();
+      TemporalEvaluatorType evaluator(first.DataSet, first.Time, FieldType(first.Electric, first.Magnetic),
+                                      second.DataSet, second.Time, FieldType(second.Electric, second.Magnetic));
+      TemporalStepper stepper(evaluator, length);
+
+      ParticleType particles(seeds, steps);
+
+      timer.Start();
+      detail::Advect(config, first.DataSet.GetCoordinateSystem().GetBounds(), particles, stepper);
+      timer.Stop();
+      std::cout << "Advection [" << first.Time << ", " << second.Time << "] : "
+                << timer.GetElapsedTime() << std::endl;
+      timer.Reset();
+
+      streams::WriteStreamlines(particles, "streams_" + std::to_string(window.GetCurrentInterval()),
+                                config.GetStreamFormat());
+      invoker(detail::ResumeParticles{}, seeds);
+    } while(window.Advance());
+    temporal::PrintOverlap(window.GetLoader());
+    return 1;
+  }
 
-    auto count = vtkm::cont::Algorithm::Reduce(filter, static_cast<vtkm::Id>(0));
-    std::cout << "Sampled " << count << " electrons" << std::endl;
+  // The field file is read in the background while the seeds are built.
+  temporal::AsyncFieldLoader loader(1);
+  loader.Request(data, 0);
 
-    std::vector<vtkm::Id> randoms;
-    GenerateRandomIndices(randoms, numSeeds, _allSeeds.GetNumberOfValues());
-    IndexType toKeep = vtkm::cont::make_ArrayHandle(randoms, vtkm::CopyFlag::On);
+  timer.Start();
 
-    vtkm::cont::ArrayHandlePermutation<IndexType, SeedsType> temp(toKeep, _allSeeds);
-    vtkm::cont::Algorithm::Copy(temp, seeds);
-  }
+  /*
+   * Make seeds based on the seeding option.
+   */
+  SeedsType seeds;
+  seeding::LoadSeeds(config, seeddata, seeds);
 
-  vtkm::cont::Invoker invoker;
-  std::cout << "Advecting " << seeds.GetNumberOfValues() << " particles" << std::endl;
+  const temporal::FieldSnapshot& fields = loader.Get(loader.Acquire());
+  const vtkm::cont::DataSet& dataset = fields.DataSet;
+  length = integration::ComputeStepLength(dataset);
 
-  vtkm::cont::ArrayHandle<vtkm::Id> initSteps;
-  invoker(detail::GetSteps{}, seeds, initSteps);
+  std::cout << "Advecting " << seeds.GetNumberOfValues() << " particles" << std::endl;
 
-  vtkm::cont::ArrayHandleConstant<vtkm::Id> particleSteps(steps, seeds.GetNumberOfValues());
-  ParticleType particles(seeds, steps);
-  vtkm::cont::ArrayHandleIndex indices(seeds.GetNumberOfValues());
+  config::IntegratorOption integrator = config.GetIntegratorOption();
+  config::PrecisionOption precision = config.GetPrecisionOption();
+  vtkm::Vec3f spacing = integration::ComputeSpacing(dataset);
+  vtkm::Bounds bounds = dataset.GetCoordinateSystem().GetBounds();
+  vtkm::FloatDefault cellSize = vtkm::Min(spacing[0], vtkm::Min(spacing[1], spacing[2]));
+  // Boris runs on its own copy of the seeds when compared against RK4,
+  // and so does the mixed precision run when compared against double.
+  SeedsType borisSeeds = seeds;
+  if(integrator == config::IntegratorOption::COMPARE)
+    vtkm::cont::ArrayCopy(seeds, borisSeeds);
+  // The scheduler benchmark starts from the seeds as they were loaded.
+  SeedsType schedulerSeeds;
+  if(config.GetWorkers() > 0)
+    vtkm::cont::ArrayCopy(seeds, schedulerSeeds);
+  SeedsType scalingSeeds;
+  if(config.GetScalingThreads() > 0)
+    vtkm::cont::ArrayCopy(seeds, scalingSeeds);
+  SeedsType mixedSeeds, mixedBorisSeeds;
+  if(precision == config::PrecisionOption::COMPARE)
+  {
+    vtkm::cont::ArrayCopy(seeds, mixedSeeds);
+    mixedBorisSeeds = mixedSeeds;
+    if(integrator == config::IntegratorOption::COMPARE)
+      vtkm::cont::ArrayCopy(seeds, mixedBorisSeeds);
+  }
 
   timer.Stop();
   std::cout << "Pre-requisite : " << timer.GetElapsedTime() << std::endl;
   timer.Reset();
 
-  timer.Start();
-  invoker(AdvectionWorklet{}, indices, stepper, particles, particleSteps);
-  timer.Stop();
+  // `tag` names the precision of the run in the output and file names.
+  auto advect = [&](const auto& evaluator, SeedsType& rk4Seeds, SeedsType& boris, const std::string& tag) {
+    using EvaluatorType = typename std::decay<decltype(evaluator)>::type;
+    std::string label = tag.empty() ? "" : " (" + tag + ")";
+    std::string suffix = tag.empty() ? "" : "_" + tag;
+
+    IndexType numPoints;
+    if(integrator != config::IntegratorOption::BORIS)
+    {
+      integration::RK4Stepper<EvaluatorType> stepper(evaluator, length);
+      ParticleType particles(rk4Seeds, steps);
+
+      timer.Start();
+      detail::Advect(config, bounds, particles, stepper);
+      timer.Stop();
+
+      vtkm::Id taken = history::CountSteps(particles, numPoints);
+      std::cout << "Advection" << label << " : " << timer.GetElapsedTime() << std::endl;
+      std::cout << "Throughput" << label << " : " << taken / timer.GetElapsedTime() << " steps/sec ("
+                << taken << " steps)" << std::endl;
+      std::cout << "History arena : " << particles.GetArenaSize() << " points" << std::endl;
+
+      timer.Reset();
+      timer.Start();
+      streams::WriteStreamlines(particles, "streams" + suffix, config.GetStreamFormat());
+      timer.Stop();
+      std::cout << "Write : " << timer.GetElapsedTime() << std::endl;
+      timer.Reset();
+    }
+
+    /*
+     * Boris covers the same simulated time as `steps` CFL steps of RK4.
+     * Its steps are one CFL length long, or `length` seconds when that is
+     * shorter, and each is split into as many substeps as the local fields
+     * require.  A `length` longer than the CFL length, such as the
+     * default 0.1, records as many points as RK4.
+     */
+    if(integrator != config::IntegratorOption::RK4)
+    {
+      vtkm::FloatDefault duration = steps * length;
+      vtkm::Id borisSteps = steps;
+      if(config.GetStepLength() < length)
+        borisSteps = static_cast<vtkm::Id>(vtkm::Ceil(duration / config.GetStepLength()));
+      borisSteps = vtkm::Max(borisSteps, vtkm::Id(1));
+      integration::BorisStepper<EvaluatorType> stepper(
+        evaluator, duration / borisSteps, config.GetCflFactor(), cellSize, boris.GetNumberOfValues());
+      ParticleType particles(boris, borisSteps);
+
+      timer.Start();
+      detail::Advect(config, bounds, particles, stepper);
+      timer.Stop();
+
+      vtkm::Id taken = history::CountSteps(particles, numPoints);
+      vtkm::Id substeps = stepper.GetNumberOfSubsteps();
+      std::cout << "Advection (Boris" << (tag.empty() ? "" : ", " + tag) << ") : "
+                << timer.GetElapsedTime() << std::endl;
+      std::cout << "Throughput (Boris" << (tag.empty() ? "" : ", " + tag) << ") : "
+                << substeps / timer.GetElapsedTime() << " steps/sec ("
+                << substeps << " substeps in " << taken << " steps)" << std::endl;
+      if(integrator == config::IntegratorOption::COMPARE)
+        detail::PrintDeviation("Deviation from RK4" + label, rk4Seeds, boris, cellSize);
+
+      streams::WriteStreamlines(particles,
+                                (integrator == config::IntegratorOption::COMPARE ? "streams_boris" : "streams") + suffix,
+                                config.GetStreamFormat());
+      timer.Reset();
+    }
+  };
+
+  integration::DispatchEvaluator(fields, precision == config::PrecisionOption::MIXED,
+                            [&](const auto& evaluator) { advect(evaluator, seeds, borisSeeds, ""); });
 
-  std::cout << "Advection : " << timer.GetElapsedTime() << std::endl;
-
-  // Has the count of points in a streamline
-  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
-  invoker(detail::ComputeNumPoints{}, seeds, initSteps, numPoints);
-  // Has all points for the streamline
-  vtkm::cont::ArrayHandle<vtkm::Vec3f> streams;
-  particles.GetCompactedHistory(streams);
-  // Calculate the indices for streamlines cell set
-  vtkm::cont::ArrayHandle<vtkm::Id> cellIndex;
-  vtkm::Id connectivityLen = vtkm::cont::Algorithm::ScanExclusive(numPoints, cellIndex);
-  // Connectivity for the cells
-  vtkm::cont::ArrayHandleCounting<vtkm::Id> connCount(0, 1, connectivityLen);
-  vtkm::cont::ArrayHandle<vtkm::Id> connectivity;
-  vtkm::cont::ArrayCopy(connCount, connectivity);
-  vtkm::cont::ArrayHandle<vtkm::UInt8> cellTypes;
-  auto polyLineShape =
-    vtkm::cont::make_ArrayHandleConstant<vtkm::UInt8>(vtkm::CELL_SHAPE_POLY_LINE, numSeeds);
-  vtkm::cont::ArrayCopy(polyLineShape, cellTypes);
-  auto numIndices = vtkm::cont::make_ArrayHandleCast(numPoints, vtkm::IdComponent());
-  auto offsets = vtkm::cont::ConvertNumComponentsToOffsets(numIndices);
-  vtkm::cont::CellSetExplicit<> polylines;
-  polylines.Fill(streams.GetNumberOfValues(), cellTypes, connectivity, offsets);
-
-  vtkm::cont::DataSet output;
-  output.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", streams));
-  output.SetCellSet(polylines);
-
-  vtkm::io::VTKDataSetWriter writer1("streams.vtk");
-  writer1.WriteDataSet(output);
+  /*
+   * Mixed precision against the double run : same seeds and integrator,
+   * fields stored in Float32.
+   */
+  if(precision == config::PrecisionOption::COMPARE)
+  {
+    integration::DispatchEvaluator(fields, true,
+                              [&](const auto& evaluator) { advect(evaluator, mixedSeeds, mixedBorisSeeds, "mixed"); });
+    if(integrator != config::IntegratorOption::BORIS)
+      detail::PrintDeviation("Deviation from double", seeds, mixedSeeds, cellSize);
+    if(integrator != config::IntegratorOption::RK4)
+      detail::PrintDeviation("Deviation from double (Boris)", borisSeeds, mixedBorisSeeds, cellSize);
+  }
+  temporal::PrintOverlap(loader);
 
+  if(config.GetEvaluatorBenchmark() > 0)
+    detail::BenchmarkEvaluators(fields, config.GetEvaluatorBenchmark());
+  if(config.GetWorkers() > 0)
+  {
+    integration::DispatchEvaluator(fields, precision == config::PrecisionOption::MIXED, [&](const auto& evaluator) {
+      detail::BenchmarkSchedulers(config, fields, evaluator, schedulerSeeds, length);
+    });
+  }
+  if(config.GetScalingThreads() > 0)
+  {
+    integration::DispatchEvaluator(fields, precision == config::PrecisionOption::MIXED, [&](const auto& evaluator) {
+      detail::BenchmarkScaling(config, bounds, evaluator, scalingSeeds, length);
+    });
+  }
   return 1;
 }
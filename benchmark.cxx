@@ -0,0 +1,316 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include <vtkm/CellShape.h>
+#include <vtkm/Math.h>
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/Timer.h>
+
+#include "ChunkedHistory.hxx"
+#include "Config.h"
+#include "Device.h"
+#include "FieldEvaluators.hxx"
+#include "FilterStreamlines.h"
+#include "Instrumentation.h"
+#include "SeedGenerator.hxx"
+#include "SyntheticFields.hxx"
+#include "ValidateOptions.hxx"
+
+namespace detail
+{
+
+using ParticleType = history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>;
+
+struct CaseResult
+{
+  std::string Field;
+  vtkm::Id Resolution;
+  vtkm::Id Seeds;
+  vtkm::Id Steps;
+  vtkm::Float64 SeedingTime;
+  vtkm::Float64 AdvectionTime;
+  vtkm::Float64 FilterTime;
+  vtkm::Id StepsTaken;
+  vtkm::Id Streamlines;
+  vtkm::Id KeptStreamlines;
+  vtkm::Float64 BytesMovedEstimate;
+  long PeakRss;
+};
+
+// Resets the peak resident set size to the current one, so that each case
+// reports its own peak rather than the largest of all cases so far.
+// Returns false where the kernel does not support it.
+bool ResetPeakRss()
+{
+  std::ofstream clearRefs("/proc/self/clear_refs");
+  clearRefs << "5" << std::endl;
+  return static_cast<bool>(clearRefs);
+}
+
+// Peak resident set size since the last ResetPeakRss, in KiB.  Falls back
+// to the peak of the whole process without /proc.
+long GetPeakRss()
+{
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while(status >> key)
+  {
+    if(key == "VmHWM:")
+    {
+      long peak;
+      if(status >> peak)
+        return peak;
+      break;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Bytes read and written by `steps` RK4 steps : every step loads and
+// stores its particle, records one point, and gathers E and B at the
+// eight corners of a cell for each of the four stages.
+vtkm::Float64 EstimateBytesMoved(vtkm::Id steps, std::size_t fieldValueSize)
+{
+  std::size_t perStep = 2 * sizeof(vtkm::ChargedParticle) + sizeof(vtkm::Vec3f) + 4 * 8 * 2 * 3 * fieldValueSize;
+  return static_cast<vtkm::Float64>(steps) * static_cast<vtkm::Float64>(perStep);
+}
+
+// Polylines of the recorded points, one per particle, as the filter
+// expects them.
+vtkm::cont::DataSet MakePolylines(const ParticleType& particles)
+{
+  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+  particles.GetNumberOfPoints(numPoints);
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+  particles.GetCompactedHistory(points);
+  vtkm::Id numLines = numPoints.GetNumberOfValues();
+
+  vtkm::cont::ArrayHandle<vtkm::Id> offsets;
+  vtkm::cont::Algorithm::ScanExtended(numPoints, offsets);
+  vtkm::cont::ArrayHandle<vtkm::Id> connectivity;
+  vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(points.GetNumberOfValues()), connectivity);
+  vtkm::cont::ArrayHandle<vtkm::UInt8> shapes;
+  vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant<vtkm::UInt8>(vtkm::CELL_SHAPE_POLY_LINE, numLines),
+                        shapes);
+
+  vtkm::cont::CellSetExplicit<> lines;
+  lines.Fill(points.GetNumberOfValues(), shapes, connectivity, offsets);
+  vtkm::cont::DataSet output;
+  output.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", points));
+  output.SetCellSet(lines);
+  return output;
+}
+
+void WriteJson(const std::string& fileName,
+               const std::string& precision,
+               vtkm::cont::DeviceAdapterId backend,
+               const std::vector<CaseResult>& results)
+{
+  std::ofstream json(fileName);
+  json << "{" << std::endl;
+  json << "  \"precision\": \"" << precision << "\"," << std::endl;
+  json << "  \"device\": \"" << backend.GetName() << "\", \"threads\": " << device::GetThreads(backend) << ","
+       << std::endl;
+  json << "  \"cases\": [" << std::endl;
+  for(std::size_t i = 0; i < results.size(); i++)
+  {
+    const CaseResult& r = results[i];
+    json << "    {\"field\": \"" << r.Field << "\", \"resolution\": " << r.Resolution
+         << ", \"seeds\": " << r.Seeds << ", \"steps\": " << r.Steps
+         << ", \"seeding_time\": " << r.SeedingTime << ", \"advection_time\": " << r.AdvectionTime
+         << ", \"filter_time\": " << r.FilterTime << ", \"steps_taken\": " << r.StepsTaken
+         << ", \"steps_per_sec\": " << (r.AdvectionTime > 0 ? r.StepsTaken / r.AdvectionTime : 0)
+         << ", \"bytes_moved_estimate\": " << r.BytesMovedEstimate
+         << ", \"bytes_per_sec_estimate\": "
+         << (r.AdvectionTime > 0 ? r.BytesMovedEstimate / r.AdvectionTime : 0)
+         << ", \"streamlines\": " << r.Streamlines << ", \"kept_streamlines\": " << r.KeptStreamlines
+         << ", \"filter_cells_per_sec\": " << (r.FilterTime > 0 ? r.Streamlines / r.FilterTime : 0)
+         << ", \"peak_rss_kb\": " << r.PeakRss << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  json << "  ]" << std::endl;
+  json << "}" << std::endl;
+}
+
+} // namespace detail
+
+/*
+ * Offline benchmark : advects synthetic electron beams through analytic
+ * fields on uniform grids, sweeping the field shape, grid resolution,
+ * seed count and step count, and writes the results as JSON.  Each case
+ * samples the seeds from a beam through the seeding path, advects them
+ * `repeats` times keeping the fastest run, and filters the streamlines.
+ */
+int main(int argc, char **argv) {
+  vtkm::cont::SetStderrLogLevel(vtkm::cont::LogLevel::Off);
+  device::SelectBuildDevice();
+
+  namespace options = boost::program_options;
+  options::options_description desc("Options");
+  desc.add_options()("fields",      options::value<std::string>()->default_value("constant:dipole:rotating"), "Field shapes, ':' separated")
+                    ("resolutions", options::value<std::string>()->default_value("32:64"), "Grid points along each axis, ':' separated")
+                    ("seeds",       options::value<std::string>()->default_value("1000:10000"), "Seed counts, ':' separated")
+                    ("steps",       options::value<std::string>()->default_value("100:1000"), "Step counts, ':' separated")
+                    ("electrons",   options::value<vtkm::Id>()->default_value(0), "Electrons in the beam the seeds are sampled from, 4x the seeds if 0")
+                    ("sampling",    options::value<std::string>()->default_value("uniform"), "Seed subsampling : uniform or weighted")
+                    ("samplingseed", options::value<vtkm::UInt32>()->default_value(314), "Random seed of the beam and its subsampling")
+                    ("threshold",   options::value<vtkm::FloatDefault>()->default_value(1), "Curvature threshold of the filter")
+                    ("precision",   options::value<std::string>()->default_value("double"), "Field storage : double or mixed")
+                    ("repeats",     options::value<vtkm::Id>()->default_value(3), "Advections per case, the fastest is kept")
+                    ("output",      options::value<std::string>()->default_value("benchmark.json"), "JSON results file")
+                    ("trace",       options::value<std::string>()->default_value(""), "Chrome trace of the stages, with a summary table at exit")
+                    ("device",      options::value<std::string>()->default_value(""), "Device to run on : serial, openmp, tbb, ... or any")
+                    ("threads",     options::value<vtkm::Id>()->default_value(0), "Threads of the device, 0 for the backend default")
+                    ("verbose",     options::value<bool>()->default_value(false), "Print the diagnostics of the evaluators and the filter");
+
+  // Every option has a default, so the params file is optional.  Without
+  // it the defaults come from the empty command line.
+  options::variables_map vm;
+  if(argc > 1)
+  {
+    std::ifstream settings_file(std::string(argv[1]), std::ifstream::in);
+    options::store(options::parse_config_file(settings_file, desc), vm);
+    settings_file.close();
+  }
+  else
+    options::store(options::parse_command_line(argc, argv, desc), vm);
+  options::notify(vm);
+
+  std::vector<synthetic::FieldShape> shapes;
+  for(const auto& name : validate::Tokenize<std::string>(vm["fields"].as<std::string>()))
+  {
+    synthetic::FieldShape shape;
+    if(!synthetic::ParseFieldShape(name, shape))
+    {
+      std::cout << "Unknown field " << name << std::endl << desc << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    shapes.push_back(shape);
+  }
+  std::vector<vtkm::Id> resolutions = validate::Tokenize<vtkm::Id>(vm["resolutions"].as<std::string>());
+  std::vector<vtkm::Id> seedCounts = validate::Tokenize<vtkm::Id>(vm["seeds"].as<std::string>());
+  std::vector<vtkm::Id> stepCounts = validate::Tokenize<vtkm::Id>(vm["steps"].as<std::string>());
+  vtkm::Id electrons = vm["electrons"].as<vtkm::Id>();
+  vtkm::UInt32 samplingSeed = vm["samplingseed"].as<vtkm::UInt32>();
+  vtkm::FloatDefault threshold = vm["threshold"].as<vtkm::FloatDefault>();
+  std::string precision = vm["precision"].as<std::string>();
+  vtkm::Id repeats = vtkm::Max(vm["repeats"].as<vtkm::Id>(), vtkm::Id(1));
+  std::string sampling = vm["sampling"].as<std::string>();
+  if((precision != "double" && precision != "mixed") || (sampling != "uniform" && sampling != "weighted") ||
+     std::any_of(resolutions.begin(), resolutions.end(), [](vtkm::Id n) { return n < 2; }))
+  {
+    std::cout << "Advection Benchmark" << std::endl << desc << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if(!device::SelectDevice(vm["device"].as<std::string>(), vm["threads"].as<vtkm::Id>()))
+    exit(EXIT_FAILURE);
+
+  instrumentation::SetVerbose(vm["verbose"].as<bool>());
+  instrumentation::Session session(vm["trace"].as<std::string>());
+  config::Config config;
+  config.SetSampling(sampling == "weighted" ? config::SamplingOption::WEIGHTED : config::SamplingOption::UNIFORM);
+  config.SetSamplingSeed(samplingSeed);
+  std::size_t fieldValueSize = precision == "mixed" ? sizeof(vtkm::Float32) : sizeof(vtkm::FloatDefault);
+
+  std::vector<detail::CaseResult> results;
+  for(synthetic::FieldShape shape : shapes)
+  {
+    for(vtkm::Id resolution : resolutions)
+    {
+      vtkm::cont::Timer timer;
+      timer.Start();
+      temporal::FieldSnapshot fields = synthetic::MakeFields(shape, vtkm::Id3(resolution));
+      timer.Stop();
+      std::cout << "Fields (" << synthetic::GetFieldShapeName(shape) << ", " << resolution << "^3) : "
+                << timer.GetElapsedTime() << std::endl;
+      vtkm::FloatDefault length = integration::ComputeStepLength(fields.DataSet);
+
+      integration::DispatchEvaluator(fields, precision == "mixed", [&](const auto& evaluator) {
+        using EvaluatorType = typename std::decay<decltype(evaluator)>::type;
+        integration::RK4Stepper<EvaluatorType> stepper(evaluator, length);
+        for(vtkm::Id numSeeds : seedCounts)
+        {
+          vtkm::cont::DataSet beam = synthetic::MakeBeam(electrons > 0 ? electrons : 4 * numSeeds, samplingSeed);
+          vtkm::cont::ArrayHandle<vtkm::ChargedParticle> seeds;
+          config.SetNumSeeds(numSeeds);
+          timer.Reset();
+          timer.Start();
+          // The seeding path of LoadSeeds, without the file read.
+          seeding::SampleLoadedSpecies(config, beam, snapshot::ParticleSnapshotReader(), seeds);
+          timer.Stop();
+          vtkm::Float64 seedingTime = timer.GetElapsedTime();
+
+          for(vtkm::Id steps : stepCounts)
+          {
+            detail::CaseResult result;
+            result.Field = synthetic::GetFieldShapeName(shape);
+            result.Resolution = resolution;
+            result.Seeds = seeds.GetNumberOfValues();
+            result.Steps = steps;
+            result.SeedingTime = seedingTime;
+            result.AdvectionTime = vtkm::Infinity64();
+            detail::ResetPeakRss();
+
+            vtkm::cont::ArrayHandle<vtkm::ChargedParticle> particles;
+            for(vtkm::Id repeat = 0; repeat < repeats; repeat++)
+            {
+              vtkm::cont::ArrayCopy(seeds, particles);
+              detail::ParticleType history(particles, steps);
+              timer.Reset();
+              timer.Start();
+              history.Advect(stepper);
+              timer.Stop();
+              result.AdvectionTime = vtkm::Min(result.AdvectionTime, timer.GetElapsedTime());
+
+              // Streamlines of the last run go through the filter.
+              if(repeat + 1 == repeats)
+              {
+                vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+                result.StepsTaken = history::CountSteps(history, numPoints);
+                vtkm::cont::DataSet lines = detail::MakePolylines(history);
+                statistics::CurvatureStatistics curvatureStats;
+                curvatureStats.Percentiles = { 50. };
+                timer.Reset();
+                timer.Start();
+                vtkm::cont::DataSet kept = FilterStreamLinesFused(lines, threshold, curvatureStats);
+                timer.Stop();
+                result.FilterTime = timer.GetElapsedTime();
+                result.Streamlines = lines.GetNumberOfCells();
+                result.KeptStreamlines = kept.GetNumberOfCells();
+              }
+            }
+            result.BytesMovedEstimate = detail::EstimateBytesMoved(result.StepsTaken, fieldValueSize);
+            result.PeakRss = detail::GetPeakRss();
+            std::cout << "Case " << result.Field << " " << resolution << "^3, " << result.Seeds << " seeds, "
+                      << steps << " steps : " << result.StepsTaken / result.AdvectionTime << " steps/sec"
+                      << std::endl;
+            results.push_back(result);
+          }
+        }
+      });
+    }
+  }
+
+  detail::WriteJson(vm["output"].as<std::string>(), precision, device::GetDevice(), results);
+  std::cout << "Results : " << vm["output"].as<std::string>() << " (" << results.size() << " cases)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,254 @@
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <mpi.h>
+
+#include "boost/program_options.hpp"
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/cont/Timer.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "ChunkedHistory.hxx"
+#include "Config.h"
+#include "Device.h"
+#include "DomainDecomposition.hxx"
+#include "FieldEvaluators.hxx"
+#include "FieldSeries.hxx"
+#include "Instrumentation.h"
+#include "ParticleExchange.hxx"
+#include "SeedGenerator.hxx"
+#include "StreamlineWriter.hxx"
+#include "ValidateOptions.hxx"
+
+namespace detail
+{
+
+struct IsRank
+{
+  VTKM_EXEC_CONT IsRank(vtkm::Id rank = 0)
+  : Rank(rank)
+  {}
+
+  VTKM_EXEC_CONT bool operator()(vtkm::Id owner) const { return owner == this->Rank; }
+
+  vtkm::Id Rank;
+};
+
+struct Statistics
+{
+  vtkm::Float64 Min;
+  vtkm::Float64 Max;
+  vtkm::Float64 Mean;
+};
+
+Statistics Gather(vtkm::Float64 value, int size)
+{
+  Statistics stats;
+  vtkm::Float64 sum;
+  MPI_Allreduce(&value, &stats.Min, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&value, &stats.Max, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  stats.Mean = sum / size;
+  return stats;
+}
+
+vtkm::Id Sum(vtkm::Id value)
+{
+  long long local = static_cast<long long>(value);
+  long long total;
+  MPI_Allreduce(&local, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  return static_cast<vtkm::Id>(total);
+}
+
+} // namespace detail
+
+/*
+ * Distributed advection : the field grid is split into z slabs, one per
+ * rank, and particles move to the rank of the next slab when they step
+ * off the side of theirs.  Every round advects the particles of each rank
+ * until they stop, then exchanges those that crossed a slab boundary.
+ * The run ends when no particle is in flight.
+ */
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  vtkm::cont::SetStderrLogLevel(vtkm::cont::LogLevel::Off);
+  device::SelectBuildDevice();
+
+  namespace options = boost::program_options;
+  options::options_description desc("Options");
+  desc.add_options()("data",    options::value<std::string>(),                    "Path to dataset")
+                    ("steps",   options::value<vtkm::Id>()->required(),           "Number of Steps")
+                    ("length",  options::value<vtkm::FloatDefault>()->required(), "Length of a single step")
+                    ("seeds",   options::value<vtkm::Id>(),        "Number of seeds for random/single seeding")
+                    ("seeddata",  options::value<std::string>(), "VTK file to read electrons from")
+                    ("threshold", options::value<vtkm::FloatDefault>()->required(), "Foltering threshold")
+                    ("sampleX",  options::value<std::string>(), "Seed sampling range X")
+                    ("sampleY",  options::value<std::string>(), "Seed sampling range Y")
+                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z")
+                    ("sampling", options::value<std::string>(), "Seed subsampling : uniform or weighted")
+                    ("samplingseed", options::value<vtkm::UInt32>(), "Random seed for seed subsampling")
+                    ("streamformat", options::value<std::string>(), "Streamline output : vtk (default) or raw")
+                    ("weakscaling", options::value<bool>(), "Multiply the number of seeds by the number of ranks")
+                    ("device", options::value<std::string>(), "Device of every rank : serial, openmp, tbb, ... or any")
+                    ("threads", options::value<vtkm::Id>(), "Threads of the device on every rank, 0 for the backend default")
+                    ("verbose", options::value<bool>(), "Print the diagnostics of the evaluators, the filter and the I/O");
+
+  options::variables_map vm;
+  std::ifstream settings_file(std::string(argv[1]), std::ifstream::in);
+  options::store(options::parse_config_file(settings_file, desc), vm);
+  settings_file.close();
+  options::notify(vm);
+
+  config::Config config;
+  int res = validate::ValidateOptions(vm, config);
+  if(res < 0)
+  {
+    if(rank == 0)
+      std::cout << "Distributed Advection Benchmark" << std::endl << desc << std::endl;
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+  // Rank 0 prints for all of them.
+  instrumentation::SetVerbose(config.IsVerbose() && rank == 0);
+  if(!device::SelectDevice(config.GetDevice(), config.GetThreads()))
+  {
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+  bool weakScaling = vm.count("weakscaling") && vm["weakscaling"].as<bool>();
+  if(weakScaling)
+    config.SetNumSeeds(config.GetNumSeeds() * size);
+
+  using SeedsType = vtkm::cont::ArrayHandle<vtkm::ChargedParticle>;
+  using ParticleType = history::ChunkedStateRecordingParticles<vtkm::ChargedParticle>;
+  vtkm::cont::Invoker invoker;
+
+  vtkm::cont::Timer timer;
+  timer.Start();
+
+  /*
+   * Every rank reads the header of the field file and seeks to the planes
+   * of its own slab.  Files the slab reader cannot index, ASCII ones or
+   * other grids, are read whole on every rank and cut down to the slab.
+   */
+  vtkm::Bounds bounds;
+  std::vector<distributed::Slab> slabs;
+  temporal::FieldSnapshot slab;
+  distributed::StructuredPointsFile header;
+  if(distributed::ReadStructuredPointsFile(config.GetDataSetName(), header))
+  {
+    bounds = header.GetBounds();
+    slabs = distributed::DecomposeSlabs(header, size);
+    slab = distributed::ReadSlab(header, slabs[static_cast<std::size_t>(rank)]);
+  }
+  else
+  {
+    temporal::FieldSnapshot fields = temporal::LoadFieldSnapshot(config.GetDataSetName(), 0);
+    bounds = fields.DataSet.GetCoordinateSystem().GetBounds();
+    slabs = distributed::DecomposeSlabs(fields.DataSet, size);
+    slab = distributed::ExtractSlab(fields, slabs[static_cast<std::size_t>(rank)]);
+  }
+  // The spacing of a slab is the spacing of the grid.
+  vtkm::FloatDefault length = integration::ComputeStepLength(slab.DataSet);
+  vtkm::cont::ArrayHandle<vtkm::Range> slabRanges = distributed::GetSlabRanges(slabs);
+
+  // Every rank samples the same seeds and keeps those in its slab.
+  SeedsType seeds;
+  {
+    SeedsType all;
+    seeding::LoadSeeds(config, config.GetSeedData(), all);
+    vtkm::cont::ArrayHandle<vtkm::Id> owners;
+    invoker(distributed::detail::Owner{}, all, slabRanges, owners);
+    vtkm::cont::Algorithm::CopyIf(all, owners, seeds, detail::IsRank(rank));
+  }
+  vtkm::Id numSeeds = detail::Sum(seeds.GetNumberOfValues());
+
+  timer.Stop();
+  vtkm::Float64 setup = timer.GetElapsedTime();
+  timer.Reset();
+
+  distributed::ParticleExchange<vtkm::ChargedParticle> exchange(MPI_COMM_WORLD);
+  vtkm::Id round = 0;
+  vtkm::Id taken = 0;
+  vtkm::Float64 advection = 0;
+  vtkm::Float64 exchanging = 0;
+  vtkm::cont::Timer wallTimer;
+  MPI_Barrier(MPI_COMM_WORLD);
+  wallTimer.Start();
+  integration::DispatchEvaluator(slab, false, [&](const auto& evaluator) {
+    using EvaluatorType = typename std::decay<decltype(evaluator)>::type;
+    integration::RK4Stepper<EvaluatorType> stepper(evaluator, length);
+    vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+    vtkm::Id inFlight;
+    do
+    {
+      ParticleType particles(seeds, config.GetNumSteps());
+      timer.Start();
+      particles.Advect(stepper);
+      timer.Stop();
+      advection += timer.GetElapsedTime();
+      taken += history::CountSteps(particles, numPoints);
+      timer.Reset();
+      if(seeds.GetNumberOfValues() > 0)
+      {
+        streams::WriteStreamlines(particles, "streams_" + std::to_string(rank) + "_" + std::to_string(round),
+                                  config.GetStreamFormat());
+      }
+
+      timer.Start();
+      vtkm::cont::ArrayHandle<vtkm::Id> destinations;
+      invoker(distributed::detail::Destination(bounds, rank), seeds, slabRanges, destinations);
+      SeedsType stopped, received;
+      exchange.Exchange(seeds, destinations, stopped, received);
+      invoker(distributed::detail::Arrive{}, received);
+      seeds = received;
+      inFlight = detail::Sum(received.GetNumberOfValues());
+      timer.Stop();
+      exchanging += timer.GetElapsedTime();
+      timer.Reset();
+      round++;
+    } while(inFlight > 0);
+  });
+  wallTimer.Stop();
+
+  /*
+   * Strong scaling : the same run on more ranks should take proportionally
+   * less time.  Weak scaling (weakscaling=true) : seeds grow with the ranks
+   * and the time should stay flat.  Efficiencies follow from the "Scaling"
+   * lines of runs at different rank counts.
+   */
+  vtkm::Float64 wall = wallTimer.GetElapsedTime();
+  detail::Statistics advectionStats = detail::Gather(advection, size);
+  detail::Statistics exchangeStats = detail::Gather(exchanging, size);
+  detail::Statistics setupStats = detail::Gather(setup, size);
+  vtkm::Id totalSteps = detail::Sum(taken);
+  vtkm::Id migrated = detail::Sum(exchange.GetNumberOfSent());
+  if(rank == 0)
+  {
+    std::cout << "Ranks : " << size << std::endl;
+    std::cout << "Seeds : " << numSeeds << std::endl;
+    std::cout << "Pre-requisite (max) : " << setupStats.Max << std::endl;
+    std::cout << "Rounds : " << round << ", migrated particles : " << migrated << std::endl;
+    std::cout << "Advection (min/mean/max) : " << advectionStats.Min << " / " << advectionStats.Mean << " / "
+              << advectionStats.Max << std::endl;
+    std::cout << "Exchange (min/mean/max) : " << exchangeStats.Min << " / " << exchangeStats.Mean << " / "
+              << exchangeStats.Max << std::endl;
+    std::cout << "Imbalance : " << (advectionStats.Mean > 0 ? advectionStats.Max / advectionStats.Mean : 1)
+              << std::endl;
+    std::cout << "Throughput : " << totalSteps / wall << " steps/sec (" << totalSteps << " steps)" << std::endl;
+    std::cout << "Scaling : " << (weakScaling ? "weak" : "strong") << " ranks=" << size << " seeds=" << numSeeds
+              << " time=" << wall << " steps/sec=" << totalSteps / wall << std::endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -2,11 +2,14 @@
 
 #include <iostream>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 
 #include <vtkm/Types.h>
 #include <vtkm/cont/Algorithm.h>
 #include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandleBasic.h>
 #include <vtkm/cont/ArrayHandlePermutation.h>
 #include <vtkm/cont/Timer.h>
 
@@ -18,7 +21,14 @@
 #include <vtkm/filter/flow/Streamline.h>
 
 #include "Config.h"
+#include "ChargedParticles.hxx"
+#include "Device.h"
+#include "FieldEvaluators.hxx"
+#include "FieldSeries.hxx"
+#include "Instrumentation.h"
+#include "ParticleSnapshot.hxx"
 #include "SeedGenerator.hxx"
+#include "SeedSampling.hxx"
 #include "ValidateOptions.hxx"
 
 #include <vtkPoints.h>
@@ -26,178 +36,144 @@
 #include <vtkPolyData.h>
 #include <vtkPolyDataWriter.h>
 #include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
 
 #include <stdio.h>
 
 namespace detail
 {
-class GetSteps : public vtkm::worklet::WorkletMapField
-{
-public:
-  VTKM_CONT
-  GetSteps() {}
-  using ControlSignature = void(FieldIn, FieldOut);
-  using ExecutionSignature = void(_1, _2);
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& p, vtkm::Id& numSteps) const
-  {
-    numSteps = p.NumSteps;
-  }
-};
-
-class ComputeNumPoints : public vtkm::worklet::WorkletMapField
-{
-public:
-  VTKM_CONT
-  ComputeNumPoints() {}
-  using ControlSignature = void(FieldIn, FieldIn, FieldOut);
-  using ExecutionSignature = void(_1, _2, _3);
-
-  // Offset is number of points in streamline.
-  // 1 (inital point) + number of steps taken (p.NumSteps - initalNumSteps)
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& p,
-                            const vtkm::Id& initialNumSteps,
-                            vtkm::Id& diff) const
-  {
-      diff = 1 + p.NumSteps - initialNumSteps;
-  }
-};
-
-class ExtractParticleData : public vtkm::worklet::WorkletMapField
-{
-public:
-  ExtractParticleData() {};
-  using ControlSignature = void (FieldIn, FieldOut, FieldOut, FieldOut, FieldOut, FieldOut);
-
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& particle,
-                            vtkm::Vec3f& position,
-                            vtkm::Vec3f& momentum,
-                            vtkm::FloatDefault& mass,
-                            vtkm::FloatDefault& charge,
-                            vtkm::FloatDefault& weighting) const
-  {
-    position  = particle.Pos;
-    momentum  = particle.Momentum;
-    mass      = particle.Mass;
-    charge    = particle.Charge;
-    weighting = particle.Weighting;
-  }
-};
+// VTK array matching vtkm::FloatDefault, so buffers can be shared.
+using VTKArrayType =
+  std::conditional<std::is_same<vtkm::FloatDefault, vtkm::Float64>::value, vtkDoubleArray, vtkFloatArray>::type;
 
-void ExtractDataSetFromSeeds(const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& seeds)
+// Writes the seeds to <name>.wxps and <name>.vtk.
+void ExtractDataSetFromSeeds(const seeding::ChargedParticles& seeds, const std::string& name)
 {
-  vtkm::cont::ArrayHandle<vtkm::Vec3f> pos, mom;
-  vtkm::cont::ArrayHandle<vtkm::FloatDefault> mass, charge, weighting;
-  vtkm::cont::Invoker invoker;
-  invoker(ExtractParticleData{}, seeds, pos, mom, mass, charge, weighting);
+  const auto& pos = seeds.GetPositions();
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> mom;
+  seeds.GetMomentaSI(mom);
+  const auto& mass = seeds.GetMass();
+  const auto& charge = seeds.GetCharge();
+  const auto& weighting = seeds.GetWeighting();
   auto numvalues = seeds.GetNumberOfValues();
 
-/*  vtkm::cont::Token token;
-  const double* p_pos  = pos.GetBuffers()[0].ReadPointerHost(token);
-  const double* p_mom  = mom.GetBuffers()[0].ReadPointerHost(token);
-  const double* p_mass = mass.GetBuffers()[0].ReadPointerHost(token);
-  const double* p_c    = charge.GetBuffers()[0].ReadPointerHost(token);
-  const double* p_w    = weighting.GetBuffers()[0].ReadPointerHost(token);
-*/
+  // The snapshot keeps the species layout, so it can be fed back as
+  // seeddata.  Constant mass and charge are only expanded here.
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> massColumn, chargeColumn;
+  vtkm::cont::ArrayCopy(mass, massColumn);
+  vtkm::cont::ArrayCopy(charge, chargeColumn);
+  snapshot::ParticleSnapshotWriter snapshotWriter(name + ".wxps");
+  snapshotWriter.AddColumn("x", pos.GetArray(0));
+  snapshotWriter.AddColumn("y", pos.GetArray(1));
+  snapshotWriter.AddColumn("z", pos.GetArray(2));
+  snapshotWriter.AddColumn("ux", seeds.GetMomenta().GetArray(0));
+  snapshotWriter.AddColumn("uy", seeds.GetMomenta().GetArray(1));
+  snapshotWriter.AddColumn("uz", seeds.GetMomenta().GetArray(2));
+  snapshotWriter.AddColumn("mass", massColumn);
+  snapshotWriter.AddColumn("charge", chargeColumn);
+  snapshotWriter.AddColumn("w", weighting);
+  snapshotWriter.SetIndexPositions(pos, 4096);
+  snapshotWriter.Write();
+
+  // Bulk export : VTK arrays are wrapped around the ArrayHandle buffers
+  // instead of being filled tuple by tuple.  Positions are interleaved in
+  // one parallel copy since the legacy writer wants AoS points.  VTK does
+  // not own the buffers (save = 1), so the handles and the token have to
+  // outlive the writer.
+  vtkm::cont::Timer timer;
+  timer.Start();
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> interleaved;
+  vtkm::cont::ArrayCopy(pos, interleaved);
+  vtkm::cont::Token token;
+  auto wrap = [&](const auto& values, const char* name, int numComponents) {
+    using ValueType = typename std::decay<decltype(values)>::type::ValueType;
+    vtkm::cont::ArrayHandleBasic<ValueType> basic(values);
+    vtkNew<VTKArrayType> array;
+    array->SetNumberOfComponents(numComponents);
+    array->SetName(name);
+    array->SetArray(reinterpret_cast<vtkm::FloatDefault*>(const_cast<ValueType*>(basic.GetReadPointer(token))),
+                    static_cast<vtkIdType>(numvalues) * numComponents, 1);
+    return array;
+  };
+
   vtkNew<vtkPoints> points;
-  points->SetDataTypeToDouble();
-  points->SetNumberOfPoints(numvalues);
-  auto p_pos = pos.ReadPortal();
-  for(int i = 0; i < numvalues; i++)
-  {
-    auto _point = p_pos.Get(i);
-    double point[3] = {_point[0], _point[1], _point[2]};
-    points->SetPoint(i, point);
-  }
+  points->SetData(wrap(interleaved, "Points", 3));
   vtkNew<vtkPolyData> polyData;
   polyData->SetPoints(points);
+  polyData->GetPointData()->AddArray(wrap(mom, "Momentum", 3));
+  polyData->GetPointData()->AddArray(wrap(massColumn, "Mass", 1));
+  polyData->GetPointData()->AddArray(wrap(chargeColumn, "Charge", 1));
+  polyData->GetPointData()->AddArray(wrap(weighting, "Weighting", 1));
 
-  vtkNew<vtkDoubleArray> momentum;
-  momentum->SetNumberOfComponents(3);
-  momentum->SetName("Momentum");
-  // Create the data to store (here we just use (0,0,0))
-  auto p_mom = mom.ReadPortal();
-  for(int i = 0; i < numvalues; i++)
-  {
-    auto _mom = p_mom.Get(i);
-    double momx[3] = {_mom[0], _mom[1], _mom[2]};
-    momentum->InsertNextTuple(momx);
-  }
-  // The data is added to FIELD data (rather than POINT data as usual)
-  polyData->GetPointData()->AddArray(momentum);
-
-  vtkNew<vtkDoubleArray> mass1;
-  mass1->SetNumberOfComponents(1);
-  mass1->SetName("Mass");
-  // Create the data to store (here we just use (0,0,0))
-  auto p_mass = mass.ReadPortal();
-  for(int i = 0; i < numvalues; i++)
+  vtkNew<vtkPolyDataWriter> writer;
+  writer->SetFileName((name + ".vtk").c_str());
+  writer->SetInputData(polyData);
+  writer->SetFileTypeToBinary();
+  writer->Write();
+  timer.Stop();
+  std::cout << "Export : " << timer.GetElapsedTime() << std::endl;
+}
+
+using SeedsType = vtkm::cont::ArrayHandle<vtkm::ChargedParticle>;
+using IndexType = vtkm::cont::ArrayHandle<vtkm::Id>;
+
+// Samples the seeds out of a species file, VTK or snapshot, and exports
+// them under `name`.
+void SampleAndExport(const config::Config& config,
+                     const std::string& seeddata,
+                     const std::string& name,
+                     SeedsType& seeds)
+{
+  // Snapshots are mapped, so the reader has to outlive the species.
+  snapshot::ParticleSnapshotReader snapshotReader;
+  vtkm::cont::DataSet seedsData;
+  if(snapshot::IsParticleSnapshot(seeddata))
   {
-    double _mass = p_mass.Get(i);
-    mass1->InsertNextTuple1(_mass);
+    snapshotReader.Open(seeddata);
+    seedsData = snapshotReader.ReadDataSet();
   }
-  // The data is added to FIELD data (rather than POINT data as usual)
-  polyData->GetPointData()->AddArray(mass1);
-
-  vtkNew<vtkDoubleArray> char1;
-  char1->SetNumberOfComponents(1);
-  char1->SetName("Charge");
-  // Create the data to store (here we just use (0,0,0))
-  auto p_char = charge.ReadPortal();
-  for(int i = 0; i < numvalues; i++)
+  else
   {
-    double _char = p_char.Get(i);
-    char1->InsertNextTuple1(_char);
+    vtkm::io::VTKDataSetReader seedsReader(seeddata);
+    seedsData = seedsReader.ReadDataSet();
   }
-  // The data is added to FIELD data (rather than POINT data as usual)
-  polyData->GetPointData()->AddArray(char1);
-
-  vtkNew<vtkDoubleArray> we1;
-  we1->SetNumberOfComponents(1);
-  we1->SetName("Weighting");
-  // Create the data to store (here we just use (0,0,0))
-  auto p_we = weighting.ReadPortal();
-  for(int i = 0; i < numvalues; i++)
+  auto species = seeding::ChargedParticles::FromDataSet(seedsData);
+  seeding::BlockIndex index;
+  seeding::BuildSpeciesIndex(seedsData, snapshotReader, index);
+  IndexType inBounds;
+  seeding::SelectSpecies(config, seedsData, index, inBounds);
+
+  auto count = inBounds.GetNumberOfValues();
+  std::cout << "Sampled " << count << " electrons" << std::endl;
+
+  IndexType toKeep;
+  seeding::SampleSeeds(config, inBounds, species.GetWeighting(), toKeep);
+  auto sampled = species.Subset(toKeep);
+  sampled.MakeChargedParticles(seeds);
+  ExtractDataSetFromSeeds(sampled, name);
+}
+
+// Reads a snapshot back and counts the seeds it does not reproduce.
+vtkm::Id CountMismatches(const std::string& fileName, const SeedsType& seeds)
+{
+  SeedsType reconstructed;
+  snapshot::ParticleSnapshotReader seedsReader(fileName);
+  auto species = seeding::ChargedParticles::FromDataSet(seedsReader.ReadDataSet());
+  species.MakeChargedParticles(reconstructed);
+
+  vtkm::Id mismatches = 0;
+  auto original = seeds.ReadPortal();
+  auto readBack = reconstructed.ReadPortal();
+  vtkm::Id numValues = vtkm::Min(original.GetNumberOfValues(), readBack.GetNumberOfValues());
+  for(vtkm::Id i = 0; i < numValues; i++)
   {
-    double _we = p_we.Get(i);
-    we1->InsertNextTuple1(_we);
+    auto a = original.Get(i);
+    auto b = readBack.Get(i);
+    if(a.Pos != b.Pos || a.Momentum != b.Momentum || a.Mass != b.Mass ||
+       a.Charge != b.Charge || a.Weighting != b.Weighting)
+      mismatches++;
   }
-  // The data is added to FIELD data (rather than POINT data as usual)
-  polyData->GetPointData()->AddArray(we1);
-
-  vtkNew<vtkPolyDataWriter> writer;
-  writer->SetFileName("output.vtk");
-  writer->SetInputData(polyData);
-  writer->SetFileTypeToBinary();
-  writer->Write();
-  std::cerr << writer->GetOutputString() << std::endl;
-/*
-  FILE* f_out;
-  f_out = fopen("temp.vtk", "w");
-  fprintf(f_out, "# vtk DataFile Version 2.0\n");
-  fprintf(f_out, "WarpX particle data\n");
-  fprintf(f_out, "BINARY\n");
-  fprintf(f_out, "DATASET POLYDATA\n");
-  fprintf(f_out, "POINTS %ld double\n", numvalues);
-  fwrite(p_pos, sizeof(vtkm::Vec3f), numvalues, f_out);
-  fprintf(f_out, "\n");
-  fprintf(f_out, "POINT_DATA %ld\n", numvalues);
-  fprintf(f_out, "VECTORS mom double\n");
-  fwrite(p_mom, sizeof(vtkm::Vec3f), numvalues, f_out);
-  fprintf(f_out, "\n");
-  fprintf(f_out, "SCALARS mass double 1\n");
-  fprintf(f_out, "LOOKUP_TABLE default\n");
-  fwrite(p_mass, sizeof(vtkm::FloatDefault), numvalues, f_out);
-  fprintf(f_out, "\n");
-  fprintf(f_out, "SCALARS charge double 1\n");
-  fprintf(f_out, "LOOKUP_TABLE default\n");
-  fwrite(p_c, sizeof(vtkm::FloatDefault), numvalues, f_out);
-  fprintf(f_out, "\n");
-  fprintf(f_out, "SCALARS w double 1\n");
-  fprintf(f_out, "LOOKUP_TABLE default\n");
-  fwrite(p_w, sizeof(vtkm::FloatDefault), numvalues, f_out);
-  fprintf(f_out, "\n");
-  fclose(f_out);
-*/
+  return mismatches + vtkm::Abs(original.GetNumberOfValues() - readBack.GetNumberOfValues());
 }
 
 void PrintSeeds(const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& seeds)
@@ -212,29 +188,28 @@ void PrintSeeds(const vtkm::cont::ArrayHandle<vtkm::ChargedParticle>& seeds)
 
 } // namespace detail
 
-void GenerateRandomIndices(std::vector<vtkm::Id>& randoms, vtkm::Id numberOfSeeds, vtkm::Id total)
-{
-  srand(314);
-  for (int index = 0; index < numberOfSeeds; index++)
-  {
-    randoms.push_back(rand() % total);
-  }
-}
-
 int main(int argc, char **argv) {
   vtkm::cont::SetStderrLogLevel(vtkm::cont::LogLevel::Off);
+  device::SelectBuildDevice();
 
   namespace options = boost::program_options;
   options::options_description desc("Options");
-  desc.add_options()("data",    options::value<std::string>()->required(),        "Path to dataset")
+  desc.add_options()("data",    options::value<std::string>(),                    "Path to dataset")
                     ("steps",   options::value<vtkm::Id>()->required(),           "Number of Steps")
                     ("length",  options::value<vtkm::FloatDefault>()->required(), "Length of a single step")
                     ("seeds",   options::value<vtkm::Id>(),        "Number of seeds for random/single seeding")
-                    ("seeddata",  options::value<std::string>()->required(), "VTK file to read electrons from")
+                    ("seeddata",  options::value<std::string>(), "VTK file to read electrons from")
                     ("threshold", options::value<vtkm::FloatDefault>()->required(), "Foltering threshold")
                     ("sampleX",  options::value<std::string>(), "Seed sampling range X")
                     ("sampleY",  options::value<std::string>(), "Seed sampling range Y")
-                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z");
+                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z")
+                    ("sampling", options::value<std::string>(), "Seed subsampling : uniform or weighted")
+                    ("samplingseed", options::value<vtkm::UInt32>(), "Random seed for seed subsampling")
+                    ("batchfields", options::value<std::string>(), "Field files or glob patterns for a batch run, ':' separated")
+                    ("batchseeds", options::value<std::string>(), "Species files or glob patterns matching batchfields, ':' separated")
+                    ("device", options::value<std::string>(), "Device to run on : serial, openmp, tbb, ... or any")
+                    ("threads", options::value<vtkm::Id>(), "Threads of the device, 0 for the backend default")
+                    ("verbose", options::value<bool>(), "Print the diagnostics of the evaluators, the filter and the I/O");
 
   options::variables_map vm;
   std::ifstream settings_file(std::string(argv[1]), std::ifstream::in);
@@ -249,6 +224,9 @@ int main(int argc, char **argv) {
     std::cout << "Advection Benchmark" << std::endl << desc << std::endl;
     exit(EXIT_FAILURE);
   }
+  if(!device::SelectDevice(config.GetDevice(), config.GetThreads()))
+    exit(EXIT_FAILURE);
+  instrumentation::SetVerbose(config.IsVerbose());
 
   std::string data = config.GetDataSetName();
   vtkm::Id steps = config.GetNumSteps();
@@ -257,138 +235,62 @@ int main(int argc, char **argv) {
   std::string seeddata = config.GetSeedData();
   vtkm::FloatDefault threshold = config.GetThreshold();
 
-  using ArrayType = vtkm::cont::ArrayHandle<vtkm::Vec3f>;
-  using SeedsType = vtkm::cont::ArrayHandle<vtkm::ChargedParticle>;
-  using IndexType = vtkm::cont::ArrayHandle<vtkm::Id>;
-/*
-  using FieldType = vtkm::worklet::flow::ElectroMagneticField<ArrayType>;
-  using IndexType = vtkm::cont::ArrayHandle<vtkm::Id>;
-  using EvaluatorType = vtkm::worklet::flow::GridEvaluator<FieldType>;
-  using IntegratorType = vtkm::worklet::flow::RK4Integrator<EvaluatorType>;
-  using Stepper = vtkm::worklet::flow::Stepper<IntegratorType, EvaluatorType>;
-  using ParticleType = vtkm::worklet::flow::StateRecordingParticles<vtkm::ChargedParticle>;
-  using AdvectionWorklet = vtkm::worklet::flow::ParticleAdvectWorklet;
-*/
-  SeedsType seeds;
-/*
+  /*
+   * A single data/seeddata pair, or every pair of a batch run.  Iteration
+   * `i` of a batch writes output_<i>.wxps, output_<i>.vtk and
+   * streams_<i>.vtk.  The next field file is read while the current pair
+   * is processed.
+   */
+  std::vector<std::string> fieldFiles = { data };
+  std::vector<std::string> seedFiles = { seeddata };
+  if(config.IsBatch())
   {
-    SeedsType allSeeds;
-    vtkm::io::VTKDataSetReader seedsReader(seeddata);
-    vtkm::cont::DataSet seedsData = seedsReader.ReadDataSet();
-    vtkm::cont::ArrayHandle<vtkm::Id> filter;
-    seeding::GenerateChargedParticles(config, seedsData, allSeeds, filter);
-    SeedsType _allSeeds;
-    vtkm::cont::Algorithm::CopyIf(allSeeds, filter, _allSeeds);
-
-    auto count = vtkm::cont::Algorithm::Reduce(filter, static_cast<vtkm::Id>(0));
-    std::cout << "Sampled " << count << " electrons" << std::endl;
-
-    std::vector<vtkm::Id> randoms;
-    GenerateRandomIndices(randoms, numSeeds, _allSeeds.GetNumberOfValues());
-    IndexType toKeep = vtkm::cont::make_ArrayHandle(randoms, vtkm::CopyFlag::On);
-
-    vtkm::cont::ArrayHandlePermutation<IndexType, SeedsType> temp(toKeep, _allSeeds);
-    vtkm::cont::Algorithm::Copy(temp, seeds);
+    fieldFiles = config.GetBatchFieldFiles();
+    seedFiles = config.GetBatchSeedFiles();
   }
-*/
-  //std::cout << "Original data" << std::endl;
-  //detail::PrintSeeds(seeds);
-
-  //detail::ExtractDataSetFromSeeds(seeds);
-
-  {
-    SeedsType allSeeds;
-    vtkm::io::VTKDataSetReader seedsReader("output.vtk");
-    vtkm::cont::DataSet seedsData = seedsReader.ReadDataSet();
-    vtkm::cont::ArrayHandle<vtkm::Vec3f> pos, mom;
-    vtkm::cont::ArrayHandle<vtkm::FloatDefault> mass, charge, w;
-
-    seedsData.GetCoordinateSystem().GetData().AsArrayHandle(pos);
-    seedsData.GetField("Momentum").GetData().AsArrayHandle(mom);
-    seedsData.GetField("Mass").GetData().AsArrayHandle(mass);
-    seedsData.GetField("Charge").GetData().AsArrayHandle(charge);
-    seedsData.GetField("Weighting").GetData().AsArrayHandle(w);
-    seeding::GenerateChargedParticles(pos, mom, mass, charge, w, allSeeds);
-    vtkm::cont::Algorithm::Copy(allSeeds, seeds);
-  }
-
-  std::cout << "Reconstructed data" << std::endl;
-  detail::PrintSeeds(seeds);
-
-  vtkm::io::VTKDataSetReader dataReader(data);
-  vtkm::cont::DataSet dataset = dataReader.ReadDataSet();
-  vtkm::cont::DynamicCellSet cells = dataset.GetCellSet();
-  vtkm::cont::CoordinateSystem coords = dataset.GetCoordinateSystem();
-
-  auto bounds = coords.GetBounds();
-  std::cout << "Bounds : " << bounds << std::endl;
-  using Structured3DType = vtkm::cont::CellSetStructured<3>;
-  Structured3DType castedCells = cells.Cast<Structured3DType>();
-  auto dims = castedCells.GetSchedulingRange(vtkm::TopologyElementTagPoint());
-  vtkm::Vec3f spacing = {bounds.X.Length() / (dims[0] - 1),
-                         bounds.Y.Length() / (dims[1] - 1),
-                         bounds.Z.Length() / (dims[2] - 1)};
-  std::cout << spacing << std::endl;
-  constexpr static vtkm::FloatDefault SPEED_OF_LIGHT =
-    static_cast<vtkm::FloatDefault>(2.99792458e8);
-  spacing = spacing * spacing;
-  length = 1.0 / (SPEED_OF_LIGHT * vtkm::Sqrt(1./spacing[0] + 1./spacing[1] + 1./spacing[2]));
-  std::cout << "CFL length : " << length << std::endl;
+  temporal::AsyncFieldLoader loader(2);
+  loader.Request(fieldFiles[0], 0);
 
   vtkm::filter::flow::Streamline streamline;
-
-  streamline.SetStepSize(length);
   streamline.SetNumberOfSteps(50);
-  streamline.SetSeeds(seeds);
   streamline.SetVectorFieldType(vtkm::filter::flow::VectorFieldType::ELECTRO_MAGNETIC_FIELD_TYPE);
   streamline.SetEField("E");
   streamline.SetBField("B");
-  auto output = streamline.Execute(dataset);
-
-  vtkm::io::VTKDataSetWriter writer1("streams.vtk");
-  writer1.WriteDataSet(output);
-
-  /*vtkm::cont::ArrayHandle<vtkm::Id> initSteps;
-  invoker(detail::GetSteps{}, seeds, initSteps);
-
-  vtkm::cont::ArrayHandleConstant<vtkm::Id> particleSteps(steps, seeds.GetNumberOfValues());
-  ParticleType particles(seeds, steps);
-  vtkm::cont::ArrayHandleIndex indices(seeds.GetNumberOfValues());
-
-  timer.Stop();
-  std::cout << "Pre-requisite : " << timer.GetElapsedTime() << std::endl;
-  timer.Reset();
 
-  timer.Start();
-  invoker(AdvectionWorklet{}, indices, stepper, particles, particleSteps);
-  timer.Stop();
-
-  std::cout << "Advection : " << timer.GetElapsedTime() << std::endl;
-
-  // Has the count of points in a streamline
-  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
-  invoker(detail::ComputeNumPoints{}, seeds, initSteps, numPoints);
-  // Has all points for the streamline
-  vtkm::cont::ArrayHandle<vtkm::Vec3f> streams;
-  particles.GetCompactedHistory(streams);
-  // Calculate the indices for streamlines cell set
-  vtkm::cont::ArrayHandle<vtkm::Id> cellIndex;
-  vtkm::Id connectivityLen = vtkm::cont::Algorithm::ScanExclusive(numPoints, cellIndex);
-  // Connectivity for the cells
-  vtkm::cont::ArrayHandleCounting<vtkm::Id> connCount(0, 1, connectivityLen);
-  vtkm::cont::ArrayHandle<vtkm::Id> connectivity;
-  vtkm::cont::ArrayCopy(connCount, connectivity);
-  vtkm::cont::ArrayHandle<vtkm::UInt8> cellTypes;
-  auto polyLineShape =
-    vtkm::cont::make_ArrayHandleConstant<vtkm::UInt8>(vtkm::CELL_SHAPE_POLY_LINE, numSeeds);
-  vtkm::cont::ArrayCopy(polyLineShape, cellTypes);
-  auto numIndices = vtkm::cont::make_ArrayHandleCast(numPoints, vtkm::IdComponent());
-  auto offsets = vtkm::cont::ConvertNumComponentsToOffsets(numIndices);
-  vtkm::cont::CellSetExplicit<> polylines;
-  polylines.Fill(streams.GetNumberOfValues(), cellTypes, connectivity, offsets);
-
-  vtkm::cont::DataSet output;
-  output.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", streams));
-  output.SetCellSet(polylines);
-*/
+  detail::SeedsType seeds;
+  vtkm::cont::Timer batchTimer;
+  batchTimer.Start();
+  for(std::size_t iteration = 0; iteration < fieldFiles.size(); iteration++)
+  {
+    std::string suffix = config.IsBatch() ? "_" + std::to_string(iteration) : "";
+    if(config.IsBatch())
+      std::cout << "Iteration " << iteration << " : " << fieldFiles[iteration]
+                << " / " << seedFiles[iteration] << std::endl;
+    detail::SampleAndExport(config, seedFiles[iteration], "output" + suffix, seeds);
+    //std::cout << "Original data" << std::endl;
+    //detail::PrintSeeds(seeds);
+    std::cout << "Snapshot mismatches : " << detail::CountMismatches("output" + suffix + ".wxps", seeds)
+              << std::endl;
+
+    std::size_t slot = loader.Acquire();
+    if(iteration + 1 < fieldFiles.size())
+      loader.Request(fieldFiles[iteration + 1], 0);
+    const vtkm::cont::DataSet& dataset = loader.Get(slot).DataSet;
+    length = integration::ComputeStepLength(dataset);
+
+    streamline.SetStepSize(length);
+    streamline.SetSeeds(seeds);
+    auto output = streamline.Execute(dataset);
+
+    vtkm::io::VTKDataSetWriter writer1("streams" + suffix + ".vtk");
+    writer1.WriteDataSet(output);
+    loader.Release(slot);
+  }
+  batchTimer.Stop();
+  if(config.IsBatch())
+  {
+    std::cout << "Batch : " << fieldFiles.size() << " iterations in "
+              << batchTimer.GetElapsedTime() << std::endl;
+    temporal::PrintOverlap(loader);
+  }
 }
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 
 #include <vtkm/Types.h>
@@ -18,43 +19,19 @@
 #include <vtkm/filter/flow/Streamline.h>
 
 #include "Config.h"
+#include "Device.h"
+#include "FieldEvaluators.hxx"
+#include "FieldSeries.hxx"
+#include "Instrumentation.h"
+#include "ParticleSnapshot.hxx"
 #include "SeedGenerator.hxx"
+#include "SeedSampling.hxx"
 #include "ValidateOptions.hxx"
 
 #include <stdio.h>
 
 namespace detail
 {
-class GetSteps : public vtkm::worklet::WorkletMapField
-{
-public:
-  VTKM_CONT
-  GetSteps() {}
-  using ControlSignature = void(FieldIn, FieldOut);
-  using ExecutionSignature = void(_1, _2);
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& p, vtkm::Id& numSteps) const
-  {
-    numSteps = p.NumSteps;
-  }
-};
-
-class ComputeNumPoints : public vtkm::worklet::WorkletMapField
-{
-public:
-  VTKM_CONT
-  ComputeNumPoints() {}
-  using ControlSignature = void(FieldIn, FieldIn, FieldOut);
-  using ExecutionSignature = void(_1, _2, _3);
-
-  // Offset is number of points in streamline.
-  // 1 (inital point) + number of steps taken (p.NumSteps - initalNumSteps)
-  VTKM_EXEC void operator()(const vtkm::ChargedParticle& p,
-                            const vtkm::Id& initialNumSteps,
-                            vtkm::Id& diff) const
-  {
-      diff = 1 + p.NumSteps - initialNumSteps;
-  }
-};
 
 class ExtractParticleData : public vtkm::worklet::WorkletMapField
 {
@@ -88,29 +65,28 @@ void ExtractDataSetFromSeeds(const vtkm::cont::ArrayHandle<vtkm::ChargedParticle
 
 } // namespace detail
 
-void GenerateRandomIndices(std::vector<vtkm::Id>& randoms, vtkm::Id numberOfSeeds, vtkm::Id total)
-{
-  srand(314);
-  for (int index = 0; index < numberOfSeeds; index++)
-  {
-    randoms.push_back(rand() % total);
-  }
-}
-
 int main(int argc, char **argv) {
   vtkm::cont::SetStderrLogLevel(vtkm::cont::LogLevel::Off);
+  device::SelectBuildDevice();
 
   namespace options = boost::program_options;
   options::options_description desc("Options");
-  desc.add_options()("data",    options::value<std::string>()->required(),        "Path to dataset")
+  desc.add_options()("data",    options::value<std::string>(),                    "Path to dataset")
                     ("steps",   options::value<vtkm::Id>()->required(),           "Number of Steps")
                     ("length",  options::value<vtkm::FloatDefault>()->required(), "Length of a single step")
                     ("seeds",   options::value<vtkm::Id>(),        "Number of seeds for random/single seeding")
-                    ("seeddata",  options::value<std::string>()->required(), "VTK file to read electrons from")
+                    ("seeddata",  options::value<std::string>(), "VTK file to read electrons from")
                     ("threshold", options::value<vtkm::FloatDefault>()->required(), "Foltering threshold")
                     ("sampleX",  options::value<std::string>(), "Seed sampling range X")
                     ("sampleY",  options::value<std::string>(), "Seed sampling range Y")
-                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z");
+                    ("sampleZ",  options::value<std::string>(), "Seed sampling range Z")
+                    ("sampling", options::value<std::string>(), "Seed subsampling : uniform or weighted")
+                    ("samplingseed", options::value<vtkm::UInt32>(), "Random seed for seed subsampling")
+                    ("batchfields", options::value<std::string>(), "Field files or glob patterns for a batch run, ':' separated")
+                    ("batchseeds", options::value<std::string>(), "Species files or glob patterns matching batchfields, ':' separated")
+                    ("device", options::value<std::string>(), "Device to run on : serial, openmp, tbb, ... or any")
+                    ("threads", options::value<vtkm::Id>(), "Threads of the device, 0 for the backend default")
+                    ("verbose", options::value<bool>(), "Print the diagnostics of the evaluators, the filter and the I/O");
 
   options::variables_map vm;
   std::ifstream settings_file(std::string(argv[1]), std::ifstream::in);
@@ -125,6 +101,9 @@ int main(int argc, char **argv) {
     std::cout << "Advection Benchmark" << std::endl << desc << std::endl;
     exit(EXIT_FAILURE);
   }
+  if(!device::SelectDevice(config.GetDevice(), config.GetThreads()))
+    exit(EXIT_FAILURE);
+  instrumentation::SetVerbose(config.IsVerbose());
 
   std::string data = config.GetDataSetName();
   vtkm::Id steps = config.GetNumSteps();
@@ -133,136 +112,78 @@ int main(int argc, char **argv) {
   std::string seeddata = config.GetSeedData();
   vtkm::FloatDefault threshold = config.GetThreshold();
 
-  using ArrayType = vtkm::cont::ArrayHandle<vtkm::Vec3f>;
   using SeedsType = vtkm::cont::ArrayHandle<vtkm::ChargedParticle>;
-  using IndexType = vtkm::cont::ArrayHandle<vtkm::Id>;
-/*
-  using FieldType = vtkm::worklet::flow::ElectroMagneticField<ArrayType>;
-  using IndexType = vtkm::cont::ArrayHandle<vtkm::Id>;
-  using EvaluatorType = vtkm::worklet::flow::GridEvaluator<FieldType>;
-  using IntegratorType = vtkm::worklet::flow::RK4Integrator<EvaluatorType>;
-  using Stepper = vtkm::worklet::flow::Stepper<IntegratorType, EvaluatorType>;
-  using ParticleType = vtkm::worklet::flow::StateRecordingParticles<vtkm::ChargedParticle>;
-  using AdvectionWorklet = vtkm::worklet::flow::ParticleAdvectWorklet;
-*/
-  vtkm::io::VTKDataSetReader dataReader(data);
-  vtkm::cont::DataSet dataset = dataReader.ReadDataSet();
-  vtkm::cont::DynamicCellSet cells = dataset.GetCellSet();
-  vtkm::cont::CoordinateSystem coords = dataset.GetCoordinateSystem();
-
-  auto bounds = coords.GetBounds();
-  std::cout << "Bounds : " << bounds << std::endl;
-  using Structured3DType = vtkm::cont::CellSetStructured<3>;
-  Structured3DType castedCells = cells.Cast<Structured3DType>();
-  auto dims = castedCells.GetSchedulingRange(vtkm::TopologyElementTagPoint());
-  vtkm::Vec3f spacing = {bounds.X.Length() / (dims[0] - 1),
-                         bounds.Y.Length() / (dims[1] - 1),
-                         bounds.Z.Length() / (dims[2] - 1)};
-  std::cout << spacing << std::endl;
-  constexpr static vtkm::FloatDefault SPEED_OF_LIGHT =
-    static_cast<vtkm::FloatDefault>(2.99792458e8);
-  spacing = spacing * spacing;
-  length = 1.0 / (SPEED_OF_LIGHT * vtkm::Sqrt(1./spacing[0] + 1./spacing[1] + 1./spacing[2]));
-  std::cout << "CFL length : " << length << std::endl;
-
-  vtkm::cont::Timer timer;
-  timer.Start();
 
-/*  ArrayType electric, magnetic;
-  dataset.GetField("E").GetData().AsArrayHandle(electric);
-  dataset.GetField("B").GetData().AsArrayHandle(magnetic);
-  FieldType electromagnetic(electric, magnetic);
-
-  EvaluatorType evaluator(coords, cells, electromagnetic);
-  Stepper stepper(evaluator, length);
-*/
   /*
-   * Make seeds based on the seeding option.
+   * A single data/seeddata pair, or every pair of a batch run.  The next
+   * field file is read while the current pair is advected, and the seeds
+   * and the streamline filter are reused from one iteration to the next.
    */
-  SeedsType seeds;
-
+  std::vector<std::string> fieldFiles = { data };
+  std::vector<std::string> seedFiles = { seeddata };
+  if(config.IsBatch())
   {
-    SeedsType allSeeds;
-    vtkm::io::VTKDataSetReader seedsReader(seeddata);
-    vtkm::cont::DataSet seedsData = seedsReader.ReadDataSet();
-    vtkm::cont::ArrayHandle<vtkm::Id> filter;
-    seeding::GenerateChargedParticles(config, seedsData, allSeeds, filter);
-    SeedsType _allSeeds;
-    vtkm::cont::Algorithm::CopyIf(allSeeds, filter, _allSeeds);
-
-    auto count = vtkm::cont::Algorithm::Reduce(filter, static_cast<vtkm::Id>(0));
-    std::cout << "Sampled " << count << " electrons" << std::endl;
-
-    std::vector<vtkm::Id> randoms;
-    GenerateRandomIndices(randoms, numSeeds, _allSeeds.GetNumberOfValues());
-    IndexType toKeep = vtkm::cont::make_ArrayHandle(randoms, vtkm::CopyFlag::On);
-
-    vtkm::cont::ArrayHandlePermutation<IndexType, SeedsType> temp(toKeep, _allSeeds);
-    vtkm::cont::Algorithm::Copy(temp, seeds);
+    fieldFiles = config.GetBatchFieldFiles();
+    seedFiles = config.GetBatchSeedFiles();
   }
-
-  detail::ExtractDataSetFromSeeds(seeds);
-
-  std::cout << "Advecting " << seeds.GetNumberOfValues() << " particles" << std::endl;
-
-  vtkm::cont::Invoker invoker;
-
-  /*vtkm::cont::ArrayHandle<vtkm::Id> initSteps;
-  invoker(detail::GetSteps{}, seeds, initSteps);
-
-  vtkm::cont::ArrayHandleConstant<vtkm::Id> particleSteps(steps, seeds.GetNumberOfValues());
-  ParticleType particles(seeds, steps);
-  vtkm::cont::ArrayHandleIndex indices(seeds.GetNumberOfValues());
-
-  timer.Stop();
-  std::cout << "Pre-requisite : " << timer.GetElapsedTime() << std::endl;
-  timer.Reset();
-
-  timer.Start();
-  invoker(AdvectionWorklet{}, indices, stepper, particles, particleSteps);
-  timer.Stop();
-
-  std::cout << "Advection : " << timer.GetElapsedTime() << std::endl;
-
-  // Has the count of points in a streamline
-  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
-  invoker(detail::ComputeNumPoints{}, seeds, initSteps, numPoints);
-  // Has all points for the streamline
-  vtkm::cont::ArrayHandle<vtkm::Vec3f> streams;
-  particles.GetCompactedHistory(streams);
-  // Calculate the indices for streamlines cell set
-  vtkm::cont::ArrayHandle<vtkm::Id> cellIndex;
-  vtkm::Id connectivityLen = vtkm::cont::Algorithm::ScanExclusive(numPoints, cellIndex);
-  // Connectivity for the cells
-  vtkm::cont::ArrayHandleCounting<vtkm::Id> connCount(0, 1, connectivityLen);
-  vtkm::cont::ArrayHandle<vtkm::Id> connectivity;
-  vtkm::cont::ArrayCopy(connCount, connectivity);
-  vtkm::cont::ArrayHandle<vtkm::UInt8> cellTypes;
-  auto polyLineShape =
-    vtkm::cont::make_ArrayHandleConstant<vtkm::UInt8>(vtkm::CELL_SHAPE_POLY_LINE, numSeeds);
-  vtkm::cont::ArrayCopy(polyLineShape, cellTypes);
-  auto numIndices = vtkm::cont::make_ArrayHandleCast(numPoints, vtkm::IdComponent());
-  auto offsets = vtkm::cont::ConvertNumComponentsToOffsets(numIndices);
-  vtkm::cont::CellSetExplicit<> polylines;
-  polylines.Fill(streams.GetNumberOfValues(), cellTypes, connectivity, offsets);
-
-  vtkm::cont::DataSet output;
-  output.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", streams));
-  output.SetCellSet(polylines);
-*/
+  temporal::AsyncFieldLoader loader(2);
+  loader.Request(fieldFiles[0], 0);
 
   vtkm::filter::flow::Streamline streamline;
-
-  streamline.SetStepSize(length);
   streamline.SetNumberOfSteps(50);
-  streamline.SetSeeds(seeds);
   streamline.SetVectorFieldType(vtkm::filter::flow::VectorFieldType::ELECTRO_MAGNETIC_FIELD_TYPE);
   streamline.SetEField("E");
   streamline.SetBField("B");
-  auto output = streamline.Execute(dataset);
 
-  vtkm::io::VTKDataSetWriter writer1("streams.vtk");
-  writer1.WriteDataSet(output);
+  SeedsType seeds;
+  vtkm::Id totalSeeds = 0;
+  vtkm::Float64 totalAdvection = 0;
+  vtkm::cont::Timer batchTimer;
+  batchTimer.Start();
+  for(std::size_t iteration = 0; iteration < fieldFiles.size(); iteration++)
+  {
+    if(config.IsBatch())
+      std::cout << "Iteration " << iteration << " : " << fieldFiles[iteration]
+                << " / " << seedFiles[iteration] << std::endl;
+    std::size_t slot = loader.Acquire();
+    if(iteration + 1 < fieldFiles.size())
+      loader.Request(fieldFiles[iteration + 1], 0);
+    const vtkm::cont::DataSet& dataset = loader.Get(slot).DataSet;
+    length = integration::ComputeStepLength(dataset);
+
+    /*
+     * Make seeds based on the seeding option.
+     */
+    seeding::LoadSeeds(config, seedFiles[iteration], seeds);
+
+    detail::ExtractDataSetFromSeeds(seeds);
+
+    std::cout << "Advecting " << seeds.GetNumberOfValues() << " particles" << std::endl;
+
+    streamline.SetStepSize(length);
+    streamline.SetSeeds(seeds);
+    vtkm::cont::Timer timer;
+    timer.Start();
+    auto output = streamline.Execute(dataset);
+    timer.Stop();
+    totalSeeds += seeds.GetNumberOfValues();
+    totalAdvection += timer.GetElapsedTime();
+    std::cout << "Advection : " << timer.GetElapsedTime() << std::endl;
+
+    vtkm::io::VTKDataSetWriter writer1(config.IsBatch() ? "streams_" + std::to_string(iteration) + ".vtk"
+                                                        : std::string("streams.vtk"));
+    writer1.WriteDataSet(output);
+    loader.Release(slot);
+  }
+  batchTimer.Stop();
+  if(config.IsBatch())
+  {
+    std::cout << "Batch : " << fieldFiles.size() << " iterations in "
+              << batchTimer.GetElapsedTime() << std::endl;
+    std::cout << "Batch throughput : " << totalSeeds / totalAdvection << " particles/sec (advection), "
+              << fieldFiles.size() / batchTimer.GetElapsedTime() << " iterations/sec (overall)" << std::endl;
+    temporal::PrintOverlap(loader);
+  }
 
   return 1;
 }